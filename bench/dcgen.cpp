@@ -0,0 +1,230 @@
+/**
+ * DummyCプログラム生成器（ベンチマーク用）
+ *
+ * 使い方:
+ *   dcgen [-functions N] [-locals N] [-stmts N] [-depth N] [-comments N]
+ *         [-seed N] [-o file]
+ *     -functions 関数定義の数（mainを除く）
+ *     -locals    関数ごとのローカル変数の数
+ *     -stmts     関数ごとの文の数（returnを除く）
+ *     -depth     式の入れ子の深さ（関数呼び出しの引数として入れ子になる）
+ *     -comments  文の前にコメントを挿入する割合（0-100）
+ *
+ * ビルド:
+ *   g++ -O2 -o dcgen bench/dcgen.cpp
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * 生成パラメータ
+ */
+struct GenOption{
+	int Functions;
+	int Locals;
+	int Stmts;
+	int Depth;
+	int Comments;
+	unsigned int Seed;
+	std::string OutputFileName;
+
+	GenOption() : Functions(100), Locals(4), Stmts(8), Depth(2), Comments(10), Seed(1){}
+};
+
+/**
+ * DummyCプログラム生成クラス
+ */
+class Generator{
+	private:
+		GenOption Opt;
+		FILE *Out;
+		unsigned int Rand;
+		std::vector<int> ParamNums; // 生成済み関数の引数の数
+		std::vector<std::string> Vars; // 生成中の関数で参照できる変数
+
+	public:
+		Generator(const GenOption &opt, FILE *out) : Opt(opt), Out(out), Rand(opt.Seed){}
+		void generate();
+
+	private:
+		int random(int n);
+		void generateFunction(int index);
+		void generateComment();
+		void generateExpression(int depth);
+		void generateOperand(int depth);
+		void generateCall(int depth);
+};
+
+/**
+ * 乱数（線形合同法）
+ * @return 0以上n未満の整数
+ */
+int Generator::random(int n){
+	Rand = Rand * 1103515245 + 12345;
+	return (Rand >> 16) % n;
+}
+
+/**
+ * プログラム全体を生成
+ */
+void Generator::generate(){
+	fprintf(Out, "/* generated by dcgen */\n");
+	for(int i = 0; i < Opt.Functions; i++)
+		generateFunction(i);
+
+	// main（最後に生成した関数を呼び出す）
+	Vars.clear();
+	fprintf(Out, "int main(){\n");
+	if(!ParamNums.empty()){
+		fprintf(Out, "\tprintnum(");
+		generateCall(Opt.Depth);
+		fprintf(Out, ");\n");
+	}
+	fprintf(Out, "\treturn 0;\n}\n");
+}
+
+/**
+ * 関数定義を1つ生成
+ * @param 関数の番号
+ */
+void Generator::generateFunction(int index){
+	int param_num = random(4);
+	Vars.clear();
+
+	fprintf(Out, "int func%d(", index);
+	for(int i = 0; i < param_num; i++){
+		fprintf(Out, "%sint p%d", i ? ", " : "", i);
+		char name[32];
+		sprintf(name, "p%d", i);
+		Vars.push_back(name);
+	}
+	fprintf(Out, "){\n");
+
+	int first_local = Vars.size();
+	for(int i = 0; i < Opt.Locals; i++){
+		fprintf(Out, "\tint local%d;\n", i);
+		char name[32];
+		sprintf(name, "local%d", i);
+		Vars.push_back(name);
+	}
+
+	for(int i = 0; i < Opt.Stmts; i++){
+		generateComment();
+		fprintf(Out, "\t");
+		// 代入文または関数呼び出し文
+		if(first_local < Vars.size() && (ParamNums.empty() || random(4) != 0)){
+			fprintf(Out, "%s = ", Vars[first_local + random(Vars.size() - first_local)].c_str());
+			generateExpression(Opt.Depth);
+		}else if(!ParamNums.empty()){
+			generateCall(Opt.Depth);
+		}else{
+			generateExpression(Opt.Depth);
+		}
+		fprintf(Out, ";\n");
+	}
+
+	generateComment();
+	fprintf(Out, "\treturn ");
+	generateExpression(Opt.Depth);
+	fprintf(Out, ";\n}\n\n");
+	ParamNums.push_back(param_num);
+}
+
+/**
+ * 一定の割合でコメントを生成
+ */
+void Generator::generateComment(){
+	if(random(100) >= Opt.Comments)
+		return;
+	if(random(2))
+		fprintf(Out, "\t// line comment %d\n", random(1000));
+	else
+		fprintf(Out, "\t/* block comment\n\t * spanning lines %d */\n", random(1000));
+}
+
+/**
+ * 式（加減乗除の並び）を生成
+ * @param 入れ子の深さ
+ */
+void Generator::generateExpression(int depth){
+	static const char *ops[] = {" + ", " - ", " * ", " / "};
+	int operand_num = 1 + random(4);
+	for(int i = 0; i < operand_num; i++){
+		if(i)
+			fprintf(Out, "%s", ops[random(4)]);
+		generateOperand(depth);
+	}
+}
+
+/**
+ * 被演算子（変数、数値、関数呼び出し）を生成
+ * @param 入れ子の深さ
+ */
+void Generator::generateOperand(int depth){
+	int kind = random(3);
+	if(kind == 0 && depth > 0 && !ParamNums.empty()){
+		generateCall(depth);
+	}else if(kind == 1 && !Vars.empty()){
+		fprintf(Out, "%s", Vars[random(Vars.size())].c_str());
+	}else{
+		fprintf(Out, "%d", 1 + random(999));
+	}
+}
+
+/**
+ * 生成済みの関数の呼び出しを生成
+ * @param 入れ子の深さ（引数はdepth-1で生成）
+ */
+void Generator::generateCall(int depth){
+	int callee = random(ParamNums.size());
+	fprintf(Out, "func%d(", callee);
+	for(int i = 0; i < ParamNums[callee]; i++){
+		if(i)
+			fprintf(Out, ", ");
+		generateExpression(depth > 0 ? depth - 1 : 0);
+	}
+	fprintf(Out, ")");
+}
+
+/**
+ * main関数
+ */
+int main(int argc, char **argv){
+	GenOption opt;
+	for(int i = 1; i < argc; i++){
+		if(i + 1 < argc && strcmp(argv[i], "-functions") == 0){
+			opt.Functions = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-locals") == 0){
+			opt.Locals = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-stmts") == 0){
+			opt.Stmts = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-depth") == 0){
+			opt.Depth = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-comments") == 0){
+			opt.Comments = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-seed") == 0){
+			opt.Seed = atoi(argv[++i]);
+		}else if(i + 1 < argc && strcmp(argv[i], "-o") == 0){
+			opt.OutputFileName = argv[++i];
+		}else{
+			fprintf(stderr, "%s は不明なオプションです\n", argv[i]);
+			return 1;
+		}
+	}
+
+	FILE *out = stdout;
+	if(!opt.OutputFileName.empty() && !(out = fopen(opt.OutputFileName.c_str(), "w"))){
+		fprintf(stderr, "%s を開けません\n", opt.OutputFileName.c_str());
+		return 1;
+	}
+
+	Generator gen(opt, out);
+	gen.generate();
+
+	if(out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * 字句解析・構文解析のベンチマーク
+ *
+ * 使い方:
+ *   frontbench [-repeat N] [-batch | -stream | -parallel-lex] [-parallel-parse] [-ast-opt] [-flat-ast] [-ast-cache dir] input.dc
+ *   LexicalAnalysisとParser::doParseの時間を別々に計測し、
+ *   tokens/s, MB/s, 最大RSS, 構文解析で読み直したトークン数を表示する
+ *   (-streamでは字句解析と構文解析が交互に進むため合計のみ表示する)
+ *   -ast-optでは定数畳み込み、定数伝播（コンパイル時の関数呼び出しの評価を含む）、
+ *   mainから到達しない関数の削除、構造の同じ関数の統合の時間と、
+ *   評価した関数呼び出し・削除した関数・統合した関数の数、
+ *   統合で減った命令の数（mem2reg前のLLVM IRの命令数、ASTから数える）も表示する
+ *   -flat-astではASTの平坦化の時間と、平坦化前後のASTのバイト数も表示する
+ *   -ast-cacheでは平坦化したASTをキャッシュに書き込み、キャッシュからの読み込み
+ *   （ソースのハッシュ値の計算を含む）の時間を字句解析から平坦化までの時間と比べる
+ *
+ * ビルド:
+ *   g++ -O2 -Iinc `llvm-config --cxxflags` -o frontbench bench/frontbench.cpp \
+ *       src/lexer.cpp src/charscan.cpp src/threadpool.cpp src/symbol.cpp src/parsestats.cpp src/arena.cpp \
+ *       src/parser.cpp src/AST.cpp src/flatast.cpp src/astcache.cpp src/astopt.cpp src/funceval.cpp src/funcdce.cpp src/funcmerge.cpp -lpthread
+ *   -DDCC_PARSE_STATSを付けると構文規則ごとの計測値も表示する
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "flatast.hpp"
+#include "astcache.hpp"
+#include "astopt.hpp"
+#include "funceval.hpp"
+#include "funcdce.hpp"
+#include "funcmerge.hpp"
+
+/**
+ * 現在時刻を秒で取得
+ */
+static double getTime(){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * 最大RSSをMBで取得
+ */
+static double getPeakRSS(){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+/**
+ * 計測結果を1行表示
+ * @param 項目名, 秒, トークン数, バイト数
+ */
+static void printResult(const char *name, double sec, long tokens, long bytes){
+	fprintf(stdout, "%-8s %9.3f ms %12.0f tokens/s %9.1f MB/s\n",
+			name, sec * 1e3, tokens / sec, bytes / sec / 1e6);
+}
+
+/**
+ * main関数
+ */
+int main(int argc, char **argv){
+	std::string input_file;
+	LexMode mode = LEX_BATCH;
+	ParseMode parse_mode = PARSE_SERIAL;
+	int repeat = 5;
+	bool with_flat = false;
+	bool with_opt = false;
+	std::string cache_dir;
+	long bytes;
+
+	for(int i = 1; i < argc; i++){
+		if(i + 1 < argc && strcmp(argv[i], "-repeat") == 0){
+			repeat = atoi(argv[++i]);
+		}else if(strcmp(argv[i], "-batch") == 0){
+			mode = LEX_BATCH;
+		}else if(strcmp(argv[i], "-stream") == 0){
+			mode = LEX_STREAM;
+		}else if(strcmp(argv[i], "-parallel-lex") == 0){
+			mode = LEX_PARALLEL;
+		}else if(strcmp(argv[i], "-parallel-parse") == 0){
+			parse_mode = PARSE_PARALLEL;
+		}else if(strcmp(argv[i], "-ast-opt") == 0){
+			with_opt = true;
+		}else if(strcmp(argv[i], "-flat-ast") == 0){
+			with_flat = true;
+		}else if(i + 1 < argc && strcmp(argv[i], "-ast-cache") == 0){
+			cache_dir = argv[++i];
+			with_flat = true;
+		}else{
+			input_file = argv[i];
+		}
+	}
+	if(input_file.empty() || repeat < 1){
+		fprintf(stderr, "usage: frontbench [-repeat N] [-batch | -stream | -parallel-lex] [-parallel-parse] [-ast-opt] [-flat-ast] [-ast-cache dir] input.dc\n");
+		return 1;
+	}
+
+	struct stat st;
+	if(stat(input_file.c_str(), &st) != 0){
+		fprintf(stderr, "file is not found\n");
+		return 1;
+	}
+	bytes = st.st_size;
+
+	// 各回の最小時間を採用
+	double best_lex = 1e30, best_parse = 1e30, best_flat = 1e30;
+	double best_fold = 1e30, best_eval = 1e30, best_dce = 1e30, best_merge = 1e30;
+	long folded = 0, simplified = 0;
+	long propagated = 0, evaluated = 0, interpreted = 0;
+	long function_num = 0, removed = 0, merged = 0, inst_num = 0, saved_inst_num = 0;
+	long tokens = 0;
+	long ast_bytes = 0;
+	size_t flat_bytes = 0;
+	int reconsumed = 0;
+	FlatAST flat;
+	for(int i = 0; i < repeat; i++){
+		double start = getTime();
+		TokenStream *token_stream = LexicalAnalysis(input_file, mode);
+		double lexed = getTime();
+		if(!token_stream){
+			fprintf(stderr, "error at lexer\n");
+			return 1;
+		}
+
+		Parser *parser = new Parser(token_stream);
+		if(!parser->doParse(parse_mode)){
+			fprintf(stderr, "error at parser\n");
+			SAFE_DELETE(parser);
+			return 1;
+		}
+		double parsed = getTime();
+
+		// 件数は構文解析後に数える（-streamでは解析中に切り出されるため）
+		// 解析成功時はEOFの位置にいる
+		tokens = token_stream->getCurIndex() + 1;
+		reconsumed = token_stream->getReconsumedTokenNum();
+		ast_bytes = parser->getAST().getArena().getAllocatedBytes();
+
+		if(with_opt){
+			double start_opt = getTime();
+			ConstantFolder folder;
+			folder.fold(parser->getAST());
+			double folded_time = getTime();
+			ConstantPropagator propagator;
+			propagator.propagate(parser->getAST());
+			double evaluated_time = getTime();
+			DeadFunctionEliminator eliminator;
+			eliminator.eliminate(parser->getAST());
+			double eliminated_time = getTime();
+			FunctionMerger merger;
+			merger.merge(parser->getAST());
+			double merged_time = getTime();
+			folded = folder.getFoldedNum() + propagator.getFoldedNum();
+			simplified = folder.getSimplifiedNum();
+			propagated = propagator.getPropagatedNum();
+			evaluated = propagator.getEvaluatedNum();
+			interpreted = propagator.getInterpretedNum();
+			function_num = eliminator.getFunctionNum();
+			removed = eliminator.getRemovedNum();
+			merged = merger.getMergedNum();
+			inst_num = merger.getTotalInstNum();
+			saved_inst_num = merger.getSavedInstNum();
+			if(folded_time - start_opt < best_fold)
+				best_fold = folded_time - start_opt;
+			if(evaluated_time - folded_time < best_eval)
+				best_eval = evaluated_time - folded_time;
+			if(eliminated_time - evaluated_time < best_dce)
+				best_dce = eliminated_time - evaluated_time;
+			if(merged_time - eliminated_time < best_merge)
+				best_merge = merged_time - eliminated_time;
+		}
+
+		if(with_flat){
+			double start_flat = getTime();
+			if(!flat.build(parser->getAST())){
+				fprintf(stderr, "error at flattening AST\n");
+				SAFE_DELETE(parser);
+				return 1;
+			}
+			double flattened = getTime();
+			flat_bytes = flat.getMemorySize();
+			if(flattened - start_flat < best_flat)
+				best_flat = flattened - start_flat;
+		}
+		SAFE_DELETE(parser);
+
+		if(lexed - start < best_lex)
+			best_lex = lexed - start;
+		if(parsed - lexed < best_parse)
+			best_parse = parsed - lexed;
+	}
+
+	fprintf(stdout, "%s: %ld bytes, %ld tokens, best of %d\n",
+			input_file.c_str(), bytes, tokens, repeat);
+	if(mode != LEX_STREAM){
+		printResult("lex", best_lex, tokens, bytes);
+		printResult("parse", best_parse, tokens, bytes);
+	}
+	printResult("total", best_lex + best_parse, tokens, bytes);
+	if(with_opt){
+		printResult("fold", best_fold, tokens, bytes);
+		printResult("eval", best_eval, tokens, bytes);
+		printResult("dce", best_dce, tokens, bytes);
+		printResult("merge", best_merge, tokens, bytes);
+		fprintf(stdout, "folded %ld, simplified %ld, propagated %ld, evaluated %ld calls (%ld interpreted)\n",
+				folded, simplified, propagated, evaluated, interpreted);
+		fprintf(stdout, "removed %ld, merged %ld of %ld functions\n", removed, merged, function_num);
+		fprintf(stdout, "IR instructions %ld -> %ld by merge (saved %ld, %.1f%%)\n",
+				inst_num, inst_num - saved_inst_num, saved_inst_num,
+				inst_num ? 100.0 * saved_inst_num / inst_num : 0.0);
+	}
+	if(with_flat){
+		printResult("flatten", best_flat, tokens, bytes);
+		fprintf(stdout, "AST bytes %ld, flat AST bytes %lu (%.1f%%)\n",
+				ast_bytes, (unsigned long)flat_bytes, ast_bytes ? 100.0 * flat_bytes / ast_bytes : 0.0);
+	}
+
+	// 最後に平坦化したASTをキャッシュに書き込み、読み込みの時間を計測
+	if(!cache_dir.empty()){
+		ASTCache cache(cache_dir);
+		double start = getTime();
+		if(!cache.open(input_file, "") || !cache.store(flat)){
+			fprintf(stderr, "error at writing AST cache\n");
+			return 1;
+		}
+		double stored = getTime();
+
+		double best_load = 1e30;
+		for(int i = 0; i < repeat; i++){
+			double start_load = getTime();
+			if(!cache.open(input_file, "") || !cache.load(flat)){
+				fprintf(stderr, "error at loading AST cache\n");
+				return 1;
+			}
+			double loaded = getTime();
+			if(loaded - start_load < best_load)
+				best_load = loaded - start_load;
+		}
+
+		struct stat cache_st;
+		stat(cache.getFileName().c_str(), &cache_st);
+		fprintf(stdout, "cache file %s, %ld bytes\n", cache.getFileName().c_str(), (long)cache_st.st_size);
+		printResult("store", stored - start, tokens, bytes);
+		printResult("cold", best_lex + best_parse + best_flat, tokens, bytes);
+		printResult("warm", best_load, tokens, bytes);
+		fprintf(stdout, "warm load is %.1fx faster than lex+parse+flatten\n",
+				(best_lex + best_parse + best_flat) / best_load);
+	}
+	fprintf(stdout, "reconsumed tokens %d\n", reconsumed);
+	fprintf(stdout, "peak RSS %.1f MB\n", getPeakRSS());
+	return 0;
+}
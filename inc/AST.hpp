@@ -6,6 +6,8 @@
 #include <vector>
 #include <llvm/Support/Casting.h>
 #include "APP.hpp"
+#include "arena.hpp"
+#include "symbol.hpp"
 
 /*
  * クラス宣言
@@ -38,15 +40,35 @@ enum AstID{
 	NumberID
 };
 
+/**
+ * 二項演算子の種類
+ * 構文解析・AST上の最適化・コード生成で共通に使う
+ */
+enum BinaryOp{
+	BINOP_ASSIGN, // =
+	BINOP_ADD,    // +
+	BINOP_SUB,    // -
+	BINOP_MUL,    // *
+	BINOP_DIV,    // /
+	BINOP_NUM
+};
+
+// 二項演算子の文字列表現を取得する
+const char *getBinaryOpString(BinaryOp op);
+
 /**
  * ASTの基底クラス
+ * ASTはすべてTranslationUnitASTのArenaから確保し（new (arena) XxxAST(...)）、
+ * TranslationUnitASTの破棄時にまとめて解放する
+ * そのため各ASTは配列もArenaに置き、デストラクタを持たない
+ * 識別子は字句解析・構文解析で共有するStringInterner（StringInterner::getGlobal）の
+ * シンボル番号で保持し、名前の文字列は必要なときにStringInternerから参照する
  */
 class BaseAST{
 	AstID ID;
 
 	public:
 	BaseAST(AstID id):ID(id){}
-	virtual ~BaseAST(){}
 	AstID getValueID() const {return ID;}
 };
 
@@ -56,10 +78,13 @@ class BaseAST{
 class TranslationUnitAST{
 	std::vector<PrototypeAST*> Prototypes;
 	std::vector<FunctionAST*> Functions;
+	Arena Nodes; // このソースのASTを確保する領域
 
 	public:
 		TranslationUnitAST(){}
-		~TranslationUnitAST();
+
+		// ASTを確保する領域を取得する
+		Arena &getArena(){return Nodes;}
 
 		// モジュールにプロトタイプ宣言を追加する
 		bool addPrototype (PrototypeAST *proto);
@@ -70,6 +95,15 @@ class TranslationUnitAST{
 		// モジュールがからか判定する
 		bool empty();
 
+		// i番目のプロトタイプ宣言を置き換える（元の宣言の領域はArenaの破棄まで残る）
+		bool replacePrototype(int i, PrototypeAST *proto);
+
+		// i番目の関数を置き換える（元の関数の領域はArenaの破棄まで残る）
+		bool replaceFunction(int i, FunctionAST *func);
+
+		// removed[i]がtrueの関数を取り除き、残りを詰める（取り除いた関数の領域はArenaの破棄まで残る）
+		void removeFunctions(const std::vector<bool> &removed);
+
 		// i番目のプロトタイプ宣言を取得する
 		PrototypeAST *getPrototype(int i){
 			if (i < Prototypes.size())
@@ -91,21 +125,30 @@ class TranslationUnitAST{
  * 関数宣言を表すAST
  */
 class PrototypeAST{
-	std::string Name;
-	std::vector<std::string> Params;
+	int Name;     // 関数名のシンボル番号
+	int *Params;  // 引数名のシンボル番号
+	int ParamNum;
 
 	public:
-		PrototypeAST (const std::string &name, const std::vector<std::string> &params)
-			: Name(name), Params(params){}
+		PrototypeAST(Arena &arena, int name, const std::vector<int> &params);
+
+		// 関数名のシンボル番号を取得する
+		int getSymbol(){return Name;}
 
 		// 関数名を取得する
-		std::string getName(){return Name;}
+		const std::string &getName(){return StringInterner::getGlobal().getString(Name);}
+
+		// i番目の引数名のシンボル番号を取得する
+		int getParamSymbol(int i){if (i<ParamNum) return Params[i]; return -1;}
 
 		// i番目の引数名を取得する
-		std::string getParamName(int i){if (i<Params.size()) return Params.at(i); return NULL;}
+		const std::string &getParamName(int i){return StringInterner::getGlobal().getString(Params[i]);}
+
+		// 引数名のシンボル番号の配列を取得する
+		const int *getParamSymbols(){return Params;}
 
 		// 引数の数を取得sる
-		int getParamNum(){return Params.size();}
+		int getParamNum(){return ParamNum;}
 };
 
 /**
@@ -117,10 +160,9 @@ class FunctionAST{
 	
 	public:
 	FunctionAST(PrototypeAST *proto, FunctionStmtAST *body) : Proto(proto), Body(body){}
-	~FunctionAST();
 
 	// 関数名を取得する
-	std::string getName(){return Proto->getName();}
+	const std::string &getName(){return Proto->getName();}
 
 	// この関数のプロトタイプ宣言を取得する
 	PrototypeAST *getPrototype(){return Proto;}
@@ -133,12 +175,11 @@ class FunctionAST{
  * 関数定義（ボディ）を表すAST
  */
 class FunctionStmtAST{
-	std::vector<VariableDeclAST*> VariableDecls;
-	std::vector<BaseAST*> StmtLists;
+	ArenaVector<VariableDeclAST*> VariableDecls;
+	ArenaVector<BaseAST*> StmtLists;
 
 	public:
-	FunctionStmtAST(){}
-	~FunctionStmtAST();
+	FunctionStmtAST(Arena &arena) : VariableDecls(arena), StmtLists(arena){}
 
 	// 関数に変数を追加する
 	bool addVariableDeclaration(VariableDeclAST *vdecl);
@@ -147,10 +188,13 @@ class FunctionStmtAST{
 	bool addStatement(BaseAST *stmt){StmtLists.push_back(stmt); return true;}
 
 	// i番目の変数を取得する
-	VariableDeclAST *getVariableDecl(int i){if(i<VariableDecls.size()) return VariableDecls.at(i); else return NULL;}
+	VariableDeclAST *getVariableDecl(int i){if(i<VariableDecls.size()) return VariableDecls[i]; else return NULL;}
 
 	// i番目のステートメントを取得する
-	BaseAST *getStatement(int i){if(i<StmtLists.size()) return StmtLists.at(i); else return NULL;}
+	BaseAST *getStatement(int i){if(i<StmtLists.size()) return StmtLists[i]; else return NULL;}
+
+	// i番目のステートメントを置き換える
+	void setStatement(int i, BaseAST *stmt){StmtLists[i] = stmt;}
 };
 
 /**
@@ -164,11 +208,11 @@ class VariableDeclAST: public BaseAST{
 		}DeclType;
 	
 	private:
-		std::string Name;
+		int Name; // 変数名のシンボル番号
 		DeclType Type;
 
 	public:
-		VariableDeclAST(const std::string &name) : BaseAST(VariableDeclID),Name(name){
+		VariableDeclAST(int name) : BaseAST(VariableDeclID),Name(name){
 		}
 
 		// VariableDeclASTなのでtrueを返す
@@ -178,10 +222,12 @@ class VariableDeclAST: public BaseAST{
 		static inline bool classof(BaseAST const* base){
 			return base->getValueID() == VariableDeclID;
 		}
-		~VariableDeclAST(){}
+
+		// 変数名のシンボル番号を取得する
+		int getSymbol(){return Name;}
 
 		// 変数名を取得する
-		std::string getName(){return Name;}
+		const std::string &getName(){return StringInterner::getGlobal().getString(Name);}
 
 		//変数の宣言種別を設定する
 		bool setDeclType(DeclType type){Type = type; return true;}
@@ -194,13 +240,12 @@ class VariableDeclAST: public BaseAST{
  * 二幸演算を表すAST
  */
 class BinaryExprAST : public BaseAST{
-	std::string Op;
+	BinaryOp Op;
 	BaseAST *LHS, *RHS;
 
 	public:
-		BinaryExprAST(std::string op, BaseAST *lhs, BaseAST *rhs) 
+		BinaryExprAST(BinaryOp op, BaseAST *lhs, BaseAST *rhs) 
 			: BaseAST(BinaryExprID),Op(op),LHS(lhs),RHS(rhs){}
-		~BinaryExprAST(){SAFE_DELETE(LHS);SAFE_DELETE(RHS);}
 
 		// BinaryExprASTなのでtrueを返す
 		static inline bool classof(BinaryExprAST const* base){return true;}
@@ -211,26 +256,34 @@ class BinaryExprAST : public BaseAST{
 		}
 
 		// 演算子を取得する
-		std::string getOp(){return Op;}
+		BinaryOp getOp(){return Op;}
+
+		// 演算子の文字列表現を取得する
+		const char *getOpString(){return getBinaryOpString(Op);}
 
 		// 左辺値を取得
 		BaseAST *getLHS(){return LHS;}
 
 		// 右辺値を取得
 		BaseAST *getRHS(){return RHS;}
+
+		// 左辺値を置き換える
+		void setLHS(BaseAST *lhs){LHS = lhs;}
+
+		// 右辺値を置き換える
+		void setRHS(BaseAST *rhs){RHS = rhs;}
 };
 
 /**
  * 関数呼び出しを表すAST
  */
 class CallExprAST : public BaseAST{
-	std::string Callee;
-	std::vector<BaseAST*> Args;
+	int Callee; // 呼び出す関数名のシンボル番号
+	BaseAST **Args;
+	int ArgNum;
 
 	public:
-		CallExprAST(const std::string &callee, std::vector<BaseAST*> &args)
-			: BaseAST(CallExprID),Callee(callee),Args(args){}
-		~CallExprAST();
+		CallExprAST(Arena &arena, int callee, std::vector<BaseAST*> &args);
 
 		// CallExprASTなのでtrueを返す
 		static inline bool classof (CallExprAST const*){return true;}
@@ -240,11 +293,20 @@ class CallExprAST : public BaseAST{
 			return base->getValueID() == CallExprID;
 		}
 
+		// 呼び出す関数名のシンボル番号を取得する
+		int getCalleeSymbol(){return Callee;}
+
 		// 呼び出す関数名を取得する
-		std::string getCallee(){return Callee;}
+		const std::string &getCallee(){return StringInterner::getGlobal().getString(Callee);}
 
 		// i番目の引数を取得する
-		BaseAST *getArgs (int i){if(i<Args.size())return Args.at(i);else return NULL;}
+		BaseAST *getArgs (int i){if(i<ArgNum)return Args[i];else return NULL;}
+
+		// 引数の数を取得する
+		int getArgNum(){return ArgNum;}
+
+		// i番目の引数を置き換える
+		void setArgs(int i, BaseAST *arg){Args[i] = arg;}
 };
 
 /**
@@ -255,7 +317,6 @@ class JumpStmtAST : public BaseAST {
 	BaseAST *Expr;
 	public:
 		JumpStmtAST(BaseAST *expr) : BaseAST(JumpStmtID),Expr(expr){}
-		~JumpStmtAST(){SAFE_DELETE(Expr);}
 
 		// JumpSgmgASTなのでtrueを返す
 		static inline bool classof(JumpStmtAST const*){return true;}
@@ -267,6 +328,9 @@ class JumpStmtAST : public BaseAST {
 
 		// returnで返すExpressionを取得する
 		BaseAST *getExpr(){return Expr;}
+
+		// returnで返すExpressionを置き換える
+		void setExpr(BaseAST *expr){Expr = expr;}
 };
 
 /**
@@ -274,11 +338,10 @@ class JumpStmtAST : public BaseAST {
  */
 class VariableAST : public BaseAST{
 	//Name
-	std::string Name;
+	int Name; // 変数名のシンボル番号
 
 	public:
-		VariableAST(const std::string &name) : BaseAST(VariableID),Name(name){}
-		~VariableAST(){}
+		VariableAST(int name) : BaseAST(VariableID),Name(name){}
 
 		// VariableASTなのでtrueを返す
 		static inline bool classof(VariableAST const*){return true;}
@@ -288,8 +351,11 @@ class VariableAST : public BaseAST{
 			return base->getValueID() == VariableID;
 		}
 
+		// 変数名のシンボル番号を取得
+		int getSymbol(){return Name;}
+
 		// 変数名を取得
-		std::string getName(){return Name;}
+		const std::string &getName(){return StringInterner::getGlobal().getString(Name);}
 };
 
 /**
@@ -300,7 +366,6 @@ class NumberAST : public BaseAST{
 	
 	public:
 		NumberAST(int val) : BaseAST(NumberID), Val(val){}
-		~NumberAST(){}
 
 		// NumberASTなのでtrueを返す
 		static inline bool classof(NumberAST const*){return true;}
@@ -326,4 +391,55 @@ class NullExprAST : public BaseAST {
 		}
 };
 
+/**
+ * ASTを再帰で辿る処理の式の深さの上限
+ * 長い式（a + b + ...は左に深い木になる）でスタックを使い切らないように、
+ * これより深い部分木は各処理で再帰せずに扱う
+ */
+static const int MaxExpressionDepth = 1000;
+
+/**
+ * ASTの種類ごとの処理を静的に呼び分けるVisitor（CRTP）
+ * 派生クラスは class X : public ASTVisitor<X, 戻り値の型> として、必要なvisitXxxだけを定義する
+ * visitはAstIDによるswitchで派生クラスのvisitXxxを直接呼ぶため、仮想関数呼び出しも
+ * isa/dyn_castの連鎖も無い。定義しなかったvisitXxxはvisitBaseに回り、既定では戻り値の型の既定値を返す
+ * 派生クラスでvisitXxxをprivateにする場合は、ASTVisitorをfriendにする
+ */
+template<typename Derived, typename RetTy = void>
+class ASTVisitor{
+	public:
+		// ASTの種類に応じたvisitXxxを呼ぶ
+		RetTy visit(BaseAST *ast){
+			Derived *derived = static_cast<Derived*>(this);
+			switch(ast->getValueID()){
+				case VariableDeclID:
+					return derived->visitVariableDecl(static_cast<VariableDeclAST*>(ast));
+				case BinaryExprID:
+					return derived->visitBinaryExpr(static_cast<BinaryExprAST*>(ast));
+				case NullExprID:
+					return derived->visitNullExpr(static_cast<NullExprAST*>(ast));
+				case CallExprID:
+					return derived->visitCallExpr(static_cast<CallExprAST*>(ast));
+				case JumpStmtID:
+					return derived->visitJumpStmt(static_cast<JumpStmtAST*>(ast));
+				case VariableID:
+					return derived->visitVariable(static_cast<VariableAST*>(ast));
+				case NumberID:
+					return derived->visitNumber(static_cast<NumberAST*>(ast));
+				default:
+					return derived->visitBase(ast);
+			}
+		}
+
+		// 既定の処理（派生クラスで隠して置き換える）
+		RetTy visitVariableDecl(VariableDeclAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitBinaryExpr(BinaryExprAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitNullExpr(NullExprAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitCallExpr(CallExprAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitJumpStmt(JumpStmtAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitVariable(VariableAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitNumber(NumberAST *ast){return static_cast<Derived*>(this)->visitBase(ast);}
+		RetTy visitBase(BaseAST *ast){return RetTy();}
+};
+
 #endif
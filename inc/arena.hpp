@@ -0,0 +1,104 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/**
+ * バンプポインタ方式のメモリ領域クラス
+ * ブロックの先頭から順に切り出すだけで個別には解放せず、
+ * 破棄時にブロックごとまとめて解放する（デストラクタは呼ばない）
+ * そのため、確保するオブジェクトはデストラクタが不要な型に限る
+ */
+class Arena{
+	private:
+		std::vector<char*> Blocks;
+		char *Cur;           // 現在のブロックの未使用領域の先頭
+		char *End;           // 現在のブロックの終端
+		long AllocatedNum;   // 確保した回数
+		long AllocatedBytes; // 確保したバイト数
+
+		// コピー禁止
+		Arena(const Arena&);
+		Arena &operator=(const Arena&);
+
+	public:
+		Arena() : Cur(NULL), End(NULL), AllocatedNum(0), AllocatedBytes(0){}
+		~Arena();
+
+		// sizeバイトの領域を確保
+		void *allocate(size_t size){
+			// ポインタ・intの境界に揃える
+			size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+			AllocatedNum++;
+			AllocatedBytes += size;
+			if(End - Cur < (ptrdiff_t)size)
+				return allocateSlow(size);
+			void *ptr = Cur;
+			Cur += size;
+			return ptr;
+		}
+
+		// 別のArenaのブロックを引き取る（引き取った後のArenaは空になる）
+		void adopt(Arena &arena);
+
+		// 確保した回数を取得
+		long getAllocatedNum(){return AllocatedNum;}
+
+		// 確保したバイト数を取得
+		long getAllocatedBytes(){return AllocatedBytes;}
+
+		// ブロック数を取得
+		int getBlockNum(){return Blocks.size();}
+
+	private:
+		void *allocateSlow(size_t size);
+};
+
+/**
+ * Arenaから確保する可変長配列
+ * 容量が足りなくなると2倍の領域を確保し直して写す（古い領域はArenaの破棄まで残る）
+ * 要素はmemcpyで写すため、ポインタなどのコピーが単純な型に限る
+ */
+template<typename T>
+class ArenaVector{
+	private:
+		Arena *Owner;
+		T *Data;
+		int Size;
+		int Capacity;
+
+	public:
+		ArenaVector(Arena &arena) : Owner(&arena), Data(NULL), Size(0), Capacity(0){}
+
+		// 末尾に要素を追加
+		void push_back(const T &value){
+			if(Size == Capacity){
+				int capacity = Capacity ? Capacity * 2 : 4;
+				T *data = (T*)Owner->allocate(sizeof(T) * capacity);
+				if(Size)
+					memcpy(data, Data, sizeof(T) * Size);
+				Data = data;
+				Capacity = capacity;
+			}
+			Data[Size++] = value;
+		}
+
+		// 要素数を取得
+		int size() const {return Size;}
+
+		// i番目の要素を取得
+		T &operator[](int i){return Data[i];}
+		const T &operator[](int i) const {return Data[i];}
+};
+
+// Arenaからオブジェクトを確保する（new (arena) T(...)）
+inline void *operator new(size_t size, Arena &arena){
+	return arena.allocate(size);
+}
+
+// コンストラクタが例外を送出した場合用（領域はArenaの破棄時に解放される）
+inline void operator delete(void *, Arena &){}
+
+#endif
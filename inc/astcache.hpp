@@ -0,0 +1,70 @@
+#ifndef ASTCACHE_HPP
+#define ASTCACHE_HPP
+
+#include <string>
+#include <vector>
+#include "flatast.hpp"
+
+// キャッシュのキーに含めるコンパイラのバージョン（ビルド時に-DDCC_VERSION=...で上書きできる）
+#ifndef DCC_VERSION
+#define DCC_VERSION "dcc-0.1"
+#endif
+
+/**
+ * 平坦化したASTのキャッシュファイルの先頭
+ * 続いてノード、文の表、変数表、関数宣言、関数定義、文字列の開始位置、文字列の順に
+ * 4バイト境界で並ぶため、mmapした領域をそのまま配列として読める
+ */
+struct ASTCacheHeader{
+	char Magic[4];                 // "DCCA"
+	unsigned int Version;          // ファイル形式のバージョン
+	unsigned long long Key;        // ソースとコンパイラのバージョンのハッシュ値
+	unsigned long long SourceSize; // ソースのバイト数
+	unsigned int NodeNum;
+	unsigned int StmtNum;
+	unsigned int VarNum;
+	unsigned int PrototypeNum;
+	unsigned int FunctionNum;
+	unsigned int StringNum;        // 文字列の数（ファイル内のシンボル番号は0からの通し番号）
+	unsigned int StringBytes;      // 文字列の合計バイト数
+	unsigned int Reserved;
+};
+
+/**
+ * ソースの内容をキーとする平坦化したASTのキャッシュ
+ * キャッシュディレクトリにキーの16進表記を名前とするファイルとして保存する
+ * シンボル番号はファイル内の通し番号に付け替えて文字列と共に保存し、読み込み時に登録し直す
+ */
+class ASTCache{
+	private:
+		std::string Dir;
+		std::string FileName;          // 現在のソースに対応するキャッシュファイル名
+		unsigned long long Key;
+		unsigned long long SourceSize;
+
+	public:
+		ASTCache(const std::string &dir) : Dir(dir), Key(0), SourceSize(0){}
+
+		// ソースファイルを読んでキーを求める（失敗時はfalse）
+		// ASTを変えるオプションはoptionsに渡してキーに含める
+		bool open(const std::string &source_file, const std::string &options);
+
+		// キャッシュから読み込む（無い・壊れている場合はfalse）
+		bool load(FlatAST &flat);
+
+		// キャッシュに書き込む
+		bool store(FlatAST &flat);
+
+		// キャッシュファイル名を取得
+		const std::string &getFileName(){return FileName;}
+
+		// バイト列のハッシュ値を求める（hashは前回までのハッシュ値）
+		static unsigned long long computeHash(const char *data, size_t size, unsigned long long hash);
+		static unsigned long long computeHash(const char *data, size_t size);
+
+	private:
+		bool read(const char *data, size_t size, FlatAST &flat);
+		int addSymbol(int symbol, std::vector<int> &local, std::vector<int> &symbols);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef ASTOPT_HPP
+#define ASTOPT_HPP
+
+#include "AST.hpp"
+
+/**
+ * AST上の定数畳み込み・代数的簡約
+ * 実行時に未定義となる除算（0での除算、INT_MIN / -1）は畳み込まない
+ */
+class ConstantFolder : public ASTVisitor<ConstantFolder, BaseAST*>{
+	friend class ASTVisitor<ConstantFolder, BaseAST*>;
+
+	private:
+		Arena *Nodes;        // 新たに作るNumberASTの確保先
+		bool Pure;           // 直前にvisitした式が副作用（代入・関数呼び出し）を持たないか
+		int Depth;           // 現在の式の深さ
+		long FoldedNum;      // 定数に畳み込んだ演算の数
+		long SimplifiedNum;  // 恒等式で簡約した演算の数
+
+	public:
+		ConstantFolder() : Nodes(NULL), Pure(true), Depth(0), FoldedNum(0), SimplifiedNum(0){}
+
+		// TranslationUnitASTの全関数の式を書き換える
+		void fold(TranslationUnitAST &tunit);
+
+		// 定数に畳み込んだ演算の数を取得
+		long getFoldedNum(){return FoldedNum;}
+
+		// 恒等式で簡約した演算の数を取得
+		long getSimplifiedNum(){return SimplifiedNum;}
+
+		// 定数同士の二項演算の結果を求める（畳み込めない場合はfalse）
+		static bool evaluate(BinaryOp op, int lhs, int rhs, int &result);
+
+	private:
+		BaseAST *visitBinaryExpr(BinaryExprAST *bin_expr);
+		BaseAST *visitCallExpr(CallExprAST *call_expr);
+		BaseAST *visitJumpStmt(JumpStmtAST *jump_stmt);
+		BaseAST *visitBase(BaseAST *ast);
+		BaseAST *foldExpression(BaseAST *expr);
+		BaseAST *simplify(BinaryExprAST *bin_expr, bool lhs_pure, bool rhs_pure);
+};
+
+#endif
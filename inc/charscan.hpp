@@ -0,0 +1,41 @@
+#ifndef CHARSCAN_HPP
+#define CHARSCAN_HPP
+
+/**
+ * 文字種別（ロケールに依存しない）
+ */
+enum CharClass{
+	CC_ALPHA = 1, // 英字
+	CC_DIGIT = 2, // 数字
+	CC_SPACE = 4  // 空白 (' ', '\t', '\n', '\v', '\f', '\r')
+};
+
+extern const unsigned char CharClassTable[256];
+
+// 文字種別の判定
+inline bool isAlphaChar(char c){return CharClassTable[(unsigned char)c] & CC_ALPHA;}
+inline bool isDigitChar(char c){return CharClassTable[(unsigned char)c] & CC_DIGIT;}
+inline bool isSpaceChar(char c){return CharClassTable[(unsigned char)c] & CC_SPACE;}
+
+/**
+ * 文字種別ごとの走査関数
+ * 実行時にCPUを判定し、AVX2/SSE2/スカラーのいずれかの実装を使用する
+ * いずれも[cur, end)を走査し、条件を満たさなくなった位置を返す
+ */
+
+// 英数字が続く範囲の終端を取得
+const char *scanAlnum(const char *cur, const char *end);
+
+// 数字が続く範囲の終端を取得
+const char *scanDigit(const char *cur, const char *end);
+
+// 空白が続く範囲の終端を取得（範囲内の改行数をlinesに加算）
+const char *scanSpace(const char *cur, const char *end, int *lines);
+
+// コメント終端"*/"の位置を取得（見つからない場合はend、範囲内の改行数をlinesに加算）
+const char *scanCommentEnd(const char *cur, const char *end, int *lines);
+
+// 使用中の走査実装名を取得
+const char *getScanKernelName();
+
+#endif
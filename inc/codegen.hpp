@@ -21,33 +21,60 @@
 #include<llvm/ValueSymbolTable.h>
 #include"APP.hpp"
 #include"AST.hpp"
+#include"flatast.hpp"
+#include"symbol.hpp"
 
 /**
  * コード生成クラス
+ * 文・式のASTはASTVisitorで種類ごとのvisitXxxに振り分けて生成する
+ * SSAの場合は引数・変数のallocaを作らず、変数ごとの現在の定義（値）を辿って直接参照する
+ * （Braunらの方法のうちブロック内の定義の追跡に当たる。関数本体は分岐を持たず
+ * entryブロックのみのため、ブロックをまたぐ参照やphiは生じない）
  */
-class CodeGen{
+class CodeGen : public ASTVisitor<CodeGen, llvm::Value*>{
+	friend class ASTVisitor<CodeGen, llvm::Value*>;
+
 	private:
 		llvm::Function *CurFunc;    // 現在コード生成中のFunction
 		llvm::Module *Mod;          // 生成したModuleを格納
 		llvm::IRBuilder<> *Builder; // LLVM-IRを生成するIRBuilder
+		bool WithSSA;               // allocaを使わずにSSAの値を直接生成するか
+
+		// シンボル番号をキーとする表（名前の文字列で引き直さない）
+		SymbolTable<llvm::Function*> FunctionTable; // 宣言・定義したFunction
+		SymbolTable<llvm::Value*> VariableTable;    // 生成中の関数の引数・変数のalloca（SSAの場合は現在の値）
+
+		// 平坦化したASTのコード生成で使う値のスタック
+		std::vector<llvm::Value*> ValueStack;
 	
 	public:
-		CodeGen();
+		CodeGen(bool with_ssa = false);
 		~CodeGen();
 		bool doCodeGen(TranslationUnitAST &tunit, std::string name, std::string link_file, bool with_jit);
+		bool doCodeGen(FlatAST &flat, std::string name, std::string link_file, bool with_jit);
 		llvm::Module &getModule();
 
 	private:
+		bool finishModule(std::string link_file, bool with_jit);
 		bool generateTranslationUnit(TranslationUnitAST &tunit, std::string name);
+		bool generateTranslationUnit(FlatAST &flat, std::string name);
 		llvm::Function *generateFunctionDefinition(FunctionAST *func, llvm::Module *mod);
+		llvm::Function *generateFunctionDefinition(FlatAST &flat, const FlatFunction &flat_func, llvm::Module *mod);
 		llvm::Function *generatePrototype(PrototypeAST *proto, llvm::Module *mod);
+		llvm::Function *declareFunction(int name, const int *params, int param_num, llvm::Module *mod);
+		void beginFunction(llvm::Function *func, const int *params, int param_num);
 		llvm::Value *generateFunctionStatement(FunctionStmtAST *func_stmt);
-		llvm::Value *generateVariableDeclaration(VariableDeclAST *vdecl);
-		llvm::Value *generateStatement(BaseAST *stmt);
-		llvm::Value *generateBinaryExpression(BinaryExprAST *bin_expr);
-		llvm::Value *generateCallExpression(CallExprAST *call_expr);
-		llvm::Value *generateJumpStatement(JumpStmtAST *jump_stmt);
-		llvm::Value *generateVariable(VariableAST *var);
+		llvm::Value *visitVariableDecl(VariableDeclAST *vdecl);
+		llvm::Value *generateVariableDeclaration(int symbol, bool is_param);
+		llvm::Value *readVariable(int symbol);
+		void writeVariable(int symbol, llvm::Value *value);
+		llvm::Value *generateFlatNode(const FlatNode &node);
+		llvm::Value *visitBinaryExpr(BinaryExprAST *bin_expr);
+		llvm::Value *generateBinaryOperation(BinaryOp op, llvm::Value *lhs_v, llvm::Value *rhs_v);
+		llvm::Value *visitCallExpr(CallExprAST *call_expr);
+		llvm::Value *visitJumpStmt(JumpStmtAST *jump_stmt);
+		llvm::Value *visitVariable(VariableAST *var);
+		llvm::Value *visitNumber(NumberAST *num);
 		llvm::Value *generateNumber(int value);
 		bool linkModule(llvm::Module *dest, std::string file_name);
 };
@@ -0,0 +1,118 @@
+#ifndef FLATAST_HPP
+#define FLATAST_HPP
+
+#include <utility>
+#include <vector>
+#include "AST.hpp"
+
+/**
+ * 平坦化したASTのノードの種類
+ */
+enum FlatKind{
+	FLAT_NUMBER,   // 数値（Value:値）
+	FLAT_VARIABLE, // 変数参照（Value:変数名のシンボル番号）
+	FLAT_BINARY,   // 二項演算（Op:演算子 Value:左辺の根の位置、右辺の根は直前のノード）
+	FLAT_ASSIGN,   // 代入（Value:変数名のシンボル番号、右辺の根は直前のノード）
+	FLAT_CALL,     // 関数呼び出し（Value:関数名のシンボル番号 Count:引数の数、引数は直前に順に並ぶ）
+	FLAT_RETURN,   // return文（式の根は直前のノード）
+	FLAT_NULL      // 空の文
+};
+
+/**
+ * 平坦化したASTのノード（8バイト）
+ * 式は後行順（子が親より前）に並べ、子は配列上の位置で参照する
+ */
+struct FlatNode{
+	unsigned int Kind : 4;   // FlatKind
+	unsigned int Op : 4;     // BinaryOp（FLAT_BINARYのみ）
+	unsigned int Count : 24; // 引数の数（FLAT_CALLのみ）
+	int Value;
+};
+
+// 1つの関数呼び出しに持てる引数の数の上限
+static const int FlatMaxArgNum = (1 << 24) - 1;
+
+/**
+ * 平坦化した関数宣言・関数定義
+ */
+struct FlatFunction{
+	int Name;      // 関数名のシンボル番号
+	int ParamNum;  // 引数の数
+	int VarBegin;  // 変数表の先頭（引数、ローカル変数の順。関数宣言は引数のみ）
+	int VarNum;    // 変数の数
+	int NodeBegin; // 関数本体の先頭のノード
+	int StmtBegin; // 文の表の先頭（関数宣言は0件）
+	int StmtNum;   // 文の数
+};
+
+/**
+ * 連続した配列にまとめたAST
+ * ノードはすべて1つの配列に関数定義・文の順に後行順で並び、
+ * 各文の根の位置を文の表に持つ（文kのノードは文k-1の根の次から文kの根まで）
+ * 先頭から順に読むだけで式を評価できるため、コード生成は値のスタックのみで行える
+ */
+class FlatAST{
+	friend class ASTCache;
+
+	private:
+		std::vector<FlatNode> Nodes;
+		std::vector<unsigned int> Stmts; // 文の根のノード位置
+		std::vector<int> Vars;           // 引数・変数名のシンボル番号
+		std::vector<FlatFunction> Prototypes;
+		std::vector<FlatFunction> Functions;
+
+		// 平坦化・検査用の作業領域
+		std::vector<std::pair<BaseAST*, bool> > Pending;
+		std::vector<unsigned int> Roots;
+		SymbolTable<int> Callees; // 呼び出せる関数名のシンボル番号から引数の数への表
+		SymbolTable<bool> Locals; // 検査中の関数の引数・変数名のシンボル番号
+
+	public:
+		FlatAST(){}
+
+		// TranslationUnitASTを平坦化する（保持していた内容は破棄する）
+		// 引数の数がFlatMaxArgNumを超える呼び出しがあれば失敗する
+		bool build(TranslationUnitAST &tunit);
+
+		// 保持している内容をすべて破棄する
+		void clear();
+
+		// 位置・個数が配列の範囲内に収まり、各文が1つの式として評価でき、
+		// 参照する変数・呼び出す関数（引数の数を含む）が宣言されているか検査する
+		bool verify();
+
+		// 関数宣言・関数定義が無いか判定する
+		bool empty(){return Prototypes.empty() && Functions.empty();}
+
+		// 関数宣言の数・i番目の関数宣言を取得する
+		int getPrototypeNum(){return Prototypes.size();}
+		const FlatFunction &getPrototype(int i){return Prototypes[i];}
+
+		// 関数定義の数・i番目の関数定義を取得する
+		int getFunctionNum(){return Functions.size();}
+		const FlatFunction &getFunction(int i){return Functions[i];}
+
+		// i番目のノードを取得する
+		const FlatNode &getNode(int i){return Nodes[i];}
+
+		// 文の表のi番目（文の根のノード位置）を取得する
+		unsigned int getStmt(int i){return Stmts[i];}
+
+		// 変数表のi番目（シンボル番号）を取得する
+		int getVar(int i){return Vars[i];}
+
+		// 変数表の先頭を取得する（引数のシンボル番号の配列として使う）
+		const int *getVars(int i){return i < (int)Vars.size() ? &Vars[i] : NULL;}
+
+		// 保持しているデータのバイト数を取得する
+		size_t getMemorySize();
+
+	private:
+		bool verifyFunctions();
+		FlatFunction addPrototype(PrototypeAST *proto);
+		bool addExpression(BaseAST *expr, int depth);
+		bool addDeepExpression(BaseAST *expr);
+		void addNode(FlatKind kind, int op, int count, int value);
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FUNCDCE_HPP
+#define FUNCDCE_HPP
+
+#include <string>
+#include <vector>
+#include "AST.hpp"
+
+/**
+ * 呼び出されない関数定義の削除
+ * mainと追加の起点から関数呼び出しを辿り、到達しない関数定義を取り除く
+ */
+class DeadFunctionEliminator : public ASTVisitor<DeadFunctionEliminator>{
+	friend class ASTVisitor<DeadFunctionEliminator>;
+
+	private:
+		std::vector<std::string> RootNames; // main以外の起点の関数名
+		SymbolTable<int> Functions;         // 関数名のシンボル番号から関数定義の位置への表
+		std::vector<bool> Reachable;        // 関数定義ごとの到達するか
+		std::vector<int> Worklist;          // 到達したが呼び出し先を辿っていない関数定義
+		std::vector<BaseAST*> Pending;      // 未訪問のノード
+		int FunctionNum; // 削除前の関数定義の数
+		int RemovedNum;  // 取り除いた関数定義の数
+
+	public:
+		DeadFunctionEliminator() : FunctionNum(0), RemovedNum(0){}
+
+		// main以外の起点となる関数名を追加
+		void addRoot(const std::string &name){RootNames.push_back(name);}
+
+		// 到達しない関数定義を取り除く（起点が無く何もしなかった場合はfalse）
+		bool eliminate(TranslationUnitAST &tunit);
+
+		// 削除前の関数定義の数を取得
+		int getFunctionNum(){return FunctionNum;}
+
+		// 取り除いた関数定義の数を取得
+		int getRemovedNum(){return RemovedNum;}
+
+	private:
+		bool markReachable(int symbol);
+		void visitBinaryExpr(BinaryExprAST *bin_expr);
+		void visitCallExpr(CallExprAST *call_expr);
+		void visitJumpStmt(JumpStmtAST *jump_stmt);
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef FUNCEVAL_HPP
+#define FUNCEVAL_HPP
+
+#include <map>
+#include <utility>
+#include <vector>
+#include "AST.hpp"
+
+/**
+ * 引数・変数の値（代入前の変数は値を持たない）
+ */
+struct VariableValue{
+	bool Known;
+	int Value;
+};
+
+/**
+ * 関数定義をASTのまま実行し、定数の引数での呼び出しの結果を求めるインタプリタ
+ * 定義の無い関数（printnum）の呼び出し、ConstantFolder::evaluateで求められない演算、
+ * 代入前の変数の参照を含む呼び出しは失敗とする
+ */
+class FunctionInterpreter : public ASTVisitor<FunctionInterpreter, int>{
+	friend class ASTVisitor<FunctionInterpreter, int>;
+
+	private:
+		SymbolTable<FunctionAST*> Functions;    // 関数名のシンボル番号から関数定義への表
+		SymbolTable<VariableValue> Variables;   // 実行中の関数の引数・変数の値
+		std::map<std::vector<int>, std::pair<bool, int> > Results; // 関数名・引数ごとの結果
+		long Fuel;     // 残りの実行できるノード数
+		int Depth;     // 現在の式と呼び出しの深さ
+		bool Failed;   // 結果を求められないことが分かったか
+		bool Returned; // 実行中の関数がreturnしたか
+		long CallNum;  // 実行した関数呼び出しの数
+
+	public:
+		FunctionInterpreter() : Fuel(0), Depth(0), Failed(false), Returned(false), CallNum(0){}
+
+		// TranslationUnitASTの関数定義を登録する（覚えている結果は破棄する）
+		void setTranslationUnit(TranslationUnitAST &tunit);
+
+		// 関数を定数の引数で呼び出した結果を求める（求められない場合はfalse）
+		bool call(int callee, const std::vector<int> &args, int &result);
+
+		// 実行した関数呼び出しの数を取得
+		long getCallNum(){return CallNum;}
+
+	private:
+		bool callFunction(int callee, const std::vector<int> &args, int &result);
+		int evaluateExpression(BaseAST *expr);
+		int visitBinaryExpr(BinaryExprAST *bin_expr);
+		int visitCallExpr(CallExprAST *call_expr);
+		int visitJumpStmt(JumpStmtAST *jump_stmt);
+		int visitVariable(VariableAST *var);
+		int visitNumber(NumberAST *num);
+		int visitBase(BaseAST *ast);
+};
+
+/**
+ * 関数本体内の定数伝播とコンパイル時の関数呼び出しの評価
+ * 値の分かっている変数の参照・引数がすべて定数の関数呼び出しを数値に置き換える
+ */
+class ConstantPropagator : public ASTVisitor<ConstantPropagator, BaseAST*>{
+	friend class ASTVisitor<ConstantPropagator, BaseAST*>;
+
+	private:
+		FunctionInterpreter Interpreter;
+		Arena *Nodes;                         // 新たに作るNumberASTの確保先
+		FunctionStmtAST *CurBody;             // 書き換え中の関数本体
+		SymbolTable<VariableValue> Variables; // 書き換え中の関数の引数・変数の現時点の値
+		int Depth;                            // 現在の式の深さ
+		long PropagatedNum; // 数値に置き換えた変数参照の数
+		long FoldedNum;     // 定数に畳み込んだ演算の数
+		long EvaluatedNum;  // 結果に置き換えた関数呼び出しの数
+
+	public:
+		ConstantPropagator() : Nodes(NULL), CurBody(NULL), Depth(0), PropagatedNum(0), FoldedNum(0), EvaluatedNum(0){}
+
+		// TranslationUnitASTの全関数の式を書き換える
+		void propagate(TranslationUnitAST &tunit);
+
+		// 数値に置き換えた変数参照の数を取得
+		long getPropagatedNum(){return PropagatedNum;}
+
+		// 定数に畳み込んだ演算の数を取得
+		long getFoldedNum(){return FoldedNum;}
+
+		// 結果に置き換えた関数呼び出しの数を取得
+		long getEvaluatedNum(){return EvaluatedNum;}
+
+		// コンパイル時に実行した関数呼び出しの数を取得
+		long getInterpretedNum(){return Interpreter.getCallNum();}
+
+	private:
+		BaseAST *rewriteExpression(BaseAST *expr);
+		void setValue(int symbol, bool known, int value);
+		BaseAST *visitBinaryExpr(BinaryExprAST *bin_expr);
+		BaseAST *visitCallExpr(CallExprAST *call_expr);
+		BaseAST *visitJumpStmt(JumpStmtAST *jump_stmt);
+		BaseAST *visitVariable(VariableAST *var);
+		BaseAST *visitBase(BaseAST *ast);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef FUNCMERGE_HPP
+#define FUNCMERGE_HPP
+
+#include <map>
+#include <vector>
+#include "AST.hpp"
+
+/**
+ * 関数定義の構造を整数列に書き出すクラス
+ * 変数は宣言順の番号、自分自身の呼び出しは名前によらない値で書き出す（名前を付け替えても同じ列になる）
+ */
+class FunctionEncoder : public ASTVisitor<FunctionEncoder>{
+	friend class ASTVisitor<FunctionEncoder>;
+
+	private:
+		SymbolTable<int> Locals;         // 変数名のシンボル番号から宣言順の番号への表
+		int Self;                        // 書き出し中の関数名のシンボル番号
+		int DeclNum;                     // 書き出した変数宣言の数
+		std::vector<BaseAST*> Pending;   // 未出力のノード
+		std::vector<unsigned int> *Code; // 構造の書き出し先
+		std::vector<int> *Symbols;       // 名前で区別するシンボル番号の書き出し先
+		long InstNum;                    // コード生成で生成される命令の数
+		std::vector<unsigned int> NameHashes; // シンボル番号ごとの名前のハッシュ値（未計算は0）
+
+	public:
+		FunctionEncoder() : Self(-1), DeclNum(0), Code(NULL), Symbols(NULL), InstNum(0){}
+
+		// 関数定義の構造を書き出す（書き出し先は先に空にする）
+		void encode(FunctionAST *func, std::vector<unsigned int> &code, std::vector<int> &symbols);
+
+		// 直前に書き出した関数定義から生成される命令の数を取得（mem2reg前）
+		long getInstNum(){return InstNum;}
+
+		// 書き出した構造のハッシュ値を求める（ソースやシンボル番号の割り当てによらない）
+		static unsigned long long computeHash(const std::vector<unsigned int> &code);
+
+	private:
+		void visitVariableDecl(VariableDeclAST *vdecl);
+		void visitBinaryExpr(BinaryExprAST *bin_expr);
+		void visitCallExpr(CallExprAST *call_expr);
+		void visitJumpStmt(JumpStmtAST *jump_stmt);
+		void visitVariable(VariableAST *var);
+		void visitNumber(NumberAST *num);
+		void visitBase(BaseAST *ast);
+		void encodeVariable(int symbol);
+		unsigned int getNameHash(int symbol);
+};
+
+/**
+ * 構造の同じ関数定義の統合
+ * 2つ目以降の本体を最初の関数を呼ぶだけの本体（thunk）に置き換える（命令が減らない関数は残す）
+ */
+class FunctionMerger{
+	private:
+		FunctionEncoder Encoder;
+		std::vector<unsigned long long> Hashes; // 関数ごとの構造的ハッシュ値
+		std::map<unsigned long long, std::vector<int> > Groups; // ハッシュ値ごとの統合先の関数
+		long MergedNum;    // thunkに置き換えた関数の数
+		long TotalInstNum; // 置き換え前の全関数の命令の数
+		long SavedInstNum; // 置き換えで減った命令の数
+
+	public:
+		FunctionMerger() : MergedNum(0), TotalInstNum(0), SavedInstNum(0){}
+
+		// TranslationUnitASTの構造の同じ関数定義を統合する
+		void merge(TranslationUnitAST &tunit);
+
+		// i番目の関数定義の構造的ハッシュ値を取得（置き換え前の本体のもの）
+		unsigned long long getHash(int i){return Hashes.at(i);}
+
+		// 関数定義の数を取得
+		int getFunctionNum(){return Hashes.size();}
+
+		// thunkに置き換えた関数の数を取得
+		long getMergedNum(){return MergedNum;}
+
+		// 置き換え前の全関数の命令の数を取得（mem2reg前）
+		long getTotalInstNum(){return TotalInstNum;}
+
+		// 置き換えで減った命令の数を取得（mem2reg前）
+		long getSavedInstNum(){return SavedInstNum;}
+
+	private:
+		FunctionAST *createThunk(Arena &arena, FunctionAST *func, FunctionAST *target);
+};
+
+#endif
@@ -1,13 +1,17 @@
 #ifndef LEXER_HPP
 #define LEXER_HPP
 
+#include <algorithm>
+#include <cctype>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <list>
 #include <string>
 #include <vector>
 #include "APP.hpp"
+#include "symbol.hpp"
 
 /**
  * トークン種別
@@ -15,84 +19,306 @@
 enum TokenType{
 	TOK_IDENTIFIER, // 識別子
 	TOK_DIGIT,      // 数字
-	TOK_SYMBOL,     //記号
 	TOK_INT,        // INT
 	TOK_RETURN,     // RETURN
+	TOK_LPAREN,     // (
+	TOK_RPAREN,     // )
+	TOK_LBRACE,     // {
+	TOK_RBRACE,     // }
+	TOK_SEMICOLON,  // ;
+	TOK_COMMA,      // ,
+	TOK_ASSIGN,     // =
+	TOK_PLUS,       // +
+	TOK_MINUS,      // -
+	TOK_STAR,       // *
+	TOK_SLASH,      // /
 	TOK_EOF         // EOF
 };
 
+/**
+ * ソースファイル格納クラス
+ * ファイル全体を1つの連続したバッファとして保持する
+ * (mmapできない場合はread()でヒープに読み込む)
+ */
+class SourceBuffer{
+	private:
+		const char *Buffer;
+		size_t Size;
+		bool IsMapped;
+
+		SourceBuffer(const char *buffer, size_t size, bool is_mapped)
+			: Buffer(buffer), Size(size), IsMapped(is_mapped){}
+
+	public:
+		~SourceBuffer();
+
+		// ファイルを開いてSourceBufferを生成（失敗時はNULL）
+		static SourceBuffer *open(const std::string &file_name);
+
+		// メモリ上の文字列をコピーしてSourceBufferを生成
+		static SourceBuffer *copy(const char *data, size_t size);
+
+		// バッファの先頭を取得
+		const char *getBegin(){return Buffer;}
+
+		// バッファの終端を取得
+		const char *getEnd(){return Buffer + Size;}
+
+		// バッファのバイト数を取得
+		size_t getSize(){return Size;}
+};
+
 /**
  * 個別トークン格納クラス
+ * TokenStreamから取り出した1トークン分の値を保持する
+ * 文字列はコピーせず、ソースバッファ上の範囲を参照する
  */
 class Token{
 	private:
 		TokenType Type;
-		std::string TokenString;
+		const char *Text;
+		int Length;
 		int Number;
 		int Line;
 	
 	public:
-		Token(std::string string, TokenType type,int line)
-			: TokenString(string),Type(type),Line(line){
-			if(type == TOK_DIGIT)
-				Number = atoi(string.c_str());
-			else
-				Number = 0x7fffffff;
-		};
+		Token(TokenType type, const char *text, int length, int number, int line)
+			: Type(type),Text(text),Length(length),Number(number),Line(line){};
 		~Token(){};
 
 		// トークンの種別を取得
 		TokenType getTokenType(){return Type;};
 
 		// トークンの文字列表現を取得
-		std::string getTokenString() {return TokenString;};
+		std::string getTokenString() {return std::string(Text, Length);};
+
+		// トークンの先頭位置を取得（ソースバッファ上）
+		const char *getText(){return Text;};
+
+		// トークンの文字数を取得
+		int getLength(){return Length;};
 
 		// トークンの数値を取得（種別が数字である場合に使用）
 		int getNumberValue(){return Number;};
 
+		// トークンのシンボル番号を取得（種別が識別子である場合に使用）
+		int getSymbol(){return Number;};
+
 		// トークンの出現した行数を取得
 		int getLine(){return Line;};
 };
 
 
+/**
+ * 字句解析クラス
+ * ソースバッファを先頭から走査し、呼び出されるたびに1トークンずつ切り出す
+ * 範囲を指定した場合はその範囲のみを走査する（並列字句解析用）
+ */
+class Lexer{
+	private:
+		SourceBuffer *Source;
+		const char *Cur;
+		const char *End;
+		int LineNum;
+		bool InComment; // ブロックコメントの途中か
+		bool InLineComment; // 行コメントの途中で範囲が終わったか
+		char ErrorChar; // 解析不可能だった文字
+		StringInterner *Symbols; // 識別子の登録先
+
+	public:
+		Lexer(SourceBuffer *source)
+			: Source(source), Cur(source->getBegin()), End(source->getEnd()),
+			  LineNum(0), InComment(false), InLineComment(false), ErrorChar(0), Symbols(&StringInterner::getGlobal()){}
+		Lexer(SourceBuffer *source, const char *begin, const char *end, bool in_comment, int line = 0)
+			: Source(source), Cur(begin), End(end),
+			  LineNum(line), InComment(in_comment), InLineComment(false), ErrorChar(0), Symbols(&StringInterner::getGlobal()){}
+
+		// 識別子の登録先を設定（既定は共有のStringInterner）
+		void setInterner(StringInterner *symbols){Symbols = symbols;}
+
+		// 次のトークンを切り出す（終端ではTOK_EOFを返し続ける）
+		bool lexToken(TokenType &type, int &offset, int &length, int &number, int &line);
+
+		// 解析不可能な文字のエラーを表示
+		void printError(){fprintf(stderr,"unclear token : %c\n", ErrorChar);}
+
+		// これまでに読んだ行数を取得
+		int getLineNum(){return LineNum;}
+
+		// ブロックコメントの途中で範囲が終わったか
+		bool isInComment(){return InComment;}
+
+		// 行コメントの途中で範囲が終わったか（範囲外の同じ行もコメントになる）
+		bool isInLineComment(){return InLineComment;}
+};
+
+
+/**
+ * 字句解析の方式
+ */
+enum LexMode{
+	LEX_BATCH,    // 構文解析前にファイル全体のトークンを切り出す
+	LEX_STREAM,   // 構文解析の要求に応じてトークンを切り出す
+	LEX_PARALLEL  // ファイルを行単位で分割し、複数スレッドで切り出す
+};
+
+
 /**
  * 切り出したToken格納用クラス
+ * トークンごとにオブジェクトを確保せず、種別・位置・長さ・数値・行数を
+ * それぞれ連続した配列に格納する
+ *
+ * Lexerが設定されている場合はトークンを必要になった時点で切り出し、
+ * どのチェックポイントからも参照されなくなったトークンを解放する
+ * （インデックスは解放後もファイル先頭からの通し番号のまま）
  */
 class TokenStream{
 	private:
-		std::vector<Token*> Tokens;
+		std::vector<unsigned char> Types; // トークン種別
+		std::vector<int> Offsets;         // ソースバッファ上の開始位置
+		std::vector<int> Lengths;         // 文字数
+		std::vector<int> Numbers;         // 数値（識別子はシンボル番号、それ以外は0x7fffffff）
+		std::vector<int> Lines;           // 出現した行数
 		int CurIndex;
+		int Base;                         // 配列の先頭要素のインデックス
+		int MaxIndex;                     // これまでに進んだ最大のインデックス
+		int ReconsumedNum;                // 巻き戻し後に再び読み進めたトークン数
+#ifdef DCC_PARSE_STATS
+		int RewindNum;                    // 巻き戻した回数
+#endif
+		SourceBuffer *Source; // トークンが参照するソース
+		Lexer *Lex;           // 逐次切り出し用のLexer
+		bool LexError;        // 逐次切り出し中の字句解析エラー
+		std::vector<int> Checkpoints;
 	
 	public:
-		TokenStream():CurIndex(0){}
+		TokenStream():CurIndex(0),Base(0),MaxIndex(0),ReconsumedNum(0),
+#ifdef DCC_PARSE_STATS
+			RewindNum(0),
+#endif
+			Source(NULL),Lex(NULL),LexError(false){}
 		~TokenStream();
 
+		// トークンが参照するソースを設定（所有権を移す）
+		bool setSource(SourceBuffer *source){Source = source; return true;}
+
+		// トークンが参照するソースを取得
+		SourceBuffer *getSource(){return Source;}
+
+		// 逐次切り出し用のLexerを設定（所有権を移す）
+		bool setLexer(Lexer *lex);
+
+		// 逐次切り出し中か（トークンがすべて揃っていない）
+		bool hasLexer(){return Lex != NULL;}
+
 		bool ungetToken(int Times=1);
 		bool getNextToken();
-		bool pushToken(Token *token){
-			Tokens.push_back(token);
+		bool pushToken(TokenType type, int offset, int length, int number, int line){
+			Types.push_back(type);
+			Offsets.push_back(offset);
+			Lengths.push_back(length);
+			Numbers.push_back(number);
+			Lines.push_back(line);
 			return true;
 		}
 		Token getToken();
 
+		// 別のTokenStreamのトークンを行数をずらして末尾に追加
+		// symbol_mapを指定した場合は識別子のシンボル番号を置き換える
+		bool appendTokens(TokenStream &tokens, int line_offset, const std::vector<int> *symbol_map = NULL);
+
+		// 別のTokenStreamの[begin, end)番目のトークンを末尾に追加
+		bool copyTokens(TokenStream &tokens, int begin, int end);
+
+		// 保持しているトークンをすべて破棄
+		bool clear();
+
 		// トークンの種類を取得
-		TokenType getCurType(){return Tokens[CurIndex]->getTokenType();}
+		TokenType getCurType(){return (TokenType)Types[CurIndex - Base];}
+
+		// 次のトークンの種類を取得（インデックスは進めない）
+		TokenType peekType();
 		
 		// トークンの文字列表現を取得
-		std::string getCurString(){return Tokens[CurIndex]->getTokenString();}
+		std::string getCurString(){return std::string(getCurText(), getCurLength());}
+
+		// トークンの先頭位置を取得（ソースバッファ上）
+		const char *getCurText(){return Source->getBegin() + Offsets[CurIndex - Base];}
+
+		// トークンの文字数を取得
+		int getCurLength(){return Lengths[CurIndex - Base];}
 
 		// トークンの数値を取得
-		int getCurNumVal(){return Tokens[CurIndex]->getNumberValue();}
+		int getCurNumVal(){return Numbers[CurIndex - Base];}
+
+		// トークンのシンボル番号を取得（識別子の場合）
+		int getCurSymbol(){return Numbers[CurIndex - Base];}
+
+		// トークンのソースバッファ上の開始位置を取得
+		int getCurOffset(){return Offsets[CurIndex - Base];}
+
+		// トークンの出現した行数を取得
+		int getCurLine(){return Lines[CurIndex - Base];}
+
+		// 1つ前のトークンのソースバッファ上の終了位置を取得
+		int getPrevEnd(){return Offsets[CurIndex - Base - 1] + Lengths[CurIndex - Base - 1];}
+
+		// 1つ前のトークンの出現した行数を取得
+		int getPrevLine(){return Lines[CurIndex - Base - 1];}
 
 		// 現在のインデックスを取得
 		int getCurIndex(){return CurIndex;}
 
-		// インデックスを指定した値に設定
-		bool applyTokenIndex(int index){CurIndex=index;return true;}
+		// インデックスを指定した値に設定（解放済みの位置には戻れない）
+		bool applyTokenIndex(int index){
+			if(index < Base)
+				return false;
+#ifdef DCC_PARSE_STATS
+			// 先へ進めた場合は読み飛ばしたトークンを読み進めた数に含めない
+			if(index < CurIndex)
+				RewindNum++;
+			else if(index > MaxIndex)
+				MaxIndex = index;
+#endif
+			CurIndex=index;
+			return true;
+		}
+
+		// 現在位置をチェックポイントとして登録し、そのインデックスを返す
+		// 登録中はこの位置以降のトークンが解放されない
+		int setCheckpoint(){Checkpoints.push_back(CurIndex); return CurIndex;}
+
+		// 最後に登録したチェックポイントを解除
+		bool releaseCheckpoint(){Checkpoints.pop_back(); return true;}
+
+		// 逐次切り出し中に字句解析エラーが発生したか
+		bool hasLexError(){return LexError;}
+
+		// 保持しているトークン数を取得
+		int size(){return Types.size();}
+
+		// 巻き戻した後に再び読み進めたトークン数を取得
+		int getReconsumedTokenNum(){return ReconsumedNum;}
+
+		// これまでに進んだ最大のインデックスを取得
+		int getMaxIndex(){return MaxIndex;}
+
+#ifdef DCC_PARSE_STATS
+		// 巻き戻した回数を取得（applyTokenIndex, ungetToken）
+		int getRewindNum(){return RewindNum;}
+#endif
+
 		bool printTokens();
+
+	private:
+		bool fetchToken();
+		void releaseTokens();
 };
 
 
-TokenStream *LexicalAnalysis(std::string input_filename);
+TokenStream *LexicalAnalysis(std::string input_filename, LexMode mode = LEX_BATCH);
+TokenStream *LexicalAnalysis(SourceBuffer *source, LexMode mode = LEX_BATCH);
+bool LexicalAnalysis(Lexer *lex, TokenStream *tokens);
+bool ParallelLexicalAnalysis(SourceBuffer *source, TokenStream *tokens, int num_threads = 0);
 
 #endif
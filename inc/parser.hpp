@@ -4,39 +4,119 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
-#include <map>
 #include <string>
 #include <vector>
 #include "APP.hpp"
 #include "AST.hpp"
 #include "lexer.hpp"
+#include "parsestats.hpp"
+#include "symbol.hpp"
+
+/**
+ * 関数名テーブルの要素
+ */
+struct FunctionSymbol{
+	int ParamNum;   // 引数の数
+	int DeclOffset; // 宣言した外部宣言の開始位置（これより後ろの宣言からのみ参照できる）
+};
+
+/**
+ * 外部宣言（関数宣言・関数定義）のソース上の範囲
+ */
+struct DeclRange{
+	int Begin;          // 先頭トークンの開始位置
+	int End;            // 末尾トークンの終了位置
+	int EndLine;        // 末尾トークンの行数
+	PrototypeAST *Proto; // 関数宣言（関数定義の場合はそのプロトタイプ）
+	FunctionAST *Func;   // 関数定義（関数宣言の場合はNULL）
+};
+
+/**
+ * 関数本体のトークンの範囲（インデックス）
+ */
+struct BodyRange{
+	int Begin; // "{"（関数宣言の場合は-1）
+	int End;   // "}"の次
+};
+
+struct ParseChunk;
+
+/**
+ * 構文解析の方式
+ */
+enum ParseMode{
+	PARSE_SERIAL,  // 外部宣言を先頭から順に解析する
+	PARSE_PARALLEL // プロトタイプを先に登録し、関数本体を複数スレッドで解析する
+};
+
+/**
+ * 二項演算子の表の要素
+ */
+struct BinaryOperator{
+	TokenType Type;  // 演算子のトークン種別
+	BinaryOp Op;     // BinaryExprASTの演算子
+	int Precedence;  // 優先順位（値が大きいほど強く結合する）
+};
 
 /**
  * 構文解析・意味解析クラス
+ * 各構文は現在のトークン（代入式のみ次のトークンも）で選び、巻き戻しを行わない
+ * 各トークンは一度だけ読み進めるため、解析時間はトークン数に比例する
+ * （巻き戻し後に読み直したトークン数はTokenStream::getReconsumedTokenNumで確認できる）
  */
 class Parser{
 	private:
 		TokenStream *Tokens;
 		TranslationUnitAST *TU;
+		Arena *Nodes; // ASTを確保する領域（TUのArena、並列構文解析の作業用Parserでは分割ごとのArena）
 		
-		// 意味解析用各種識別子標
-		std::vector<std::string> VariableTable;
-		std::map<std::string, int> PrototypeTable;
-		std::map<std::string, int> FunctionTable;
+		// 意味解析用各種識別子標（シンボル番号をキーとする）
+		StringInterner *Symbols;
+		SymbolTable<VariableDeclAST*> VariableTable;
+		SymbolTable<FunctionSymbol> PrototypeTable;
+		SymbolTable<FunctionSymbol> FunctionTable;
+
+		// 並列構文解析の作業用Parserの場合は関数名テーブルを持つParser
+		Parser *Parent;
+
+		// 二項演算式の組み立て用スタック
+		std::vector<BaseAST*> OperandStack;
+		std::vector<const BinaryOperator*> OperatorStack;
+
+		// 再解析用の外部宣言の範囲（ソース順）
+		std::vector<DeclRange> Decls;
+		int CurDeclOffset; // 解析中の外部宣言の開始位置
+		int ReparsedTokenNum;
+		long ParsedArenaBytes; // 全体を解析した直後のArenaの使用量
+
+#ifdef DCC_PARSE_STATS
+		// 構文規則ごとの計測値（doParseの終了時に出力する）
+		ParseStats Stats;
+#endif
+
 	public:
-		Parser(std::string filename);
+		Parser(std::string filename, LexMode mode = LEX_BATCH);
+		Parser(TokenStream *tokens);
 		~Parser() {SAFE_DELETE(TU);SAFE_DELETE(Tokens);}
-		bool doParse();
+		bool doParse(ParseMode mode = PARSE_SERIAL);
 		TranslationUnitAST &getAST();
 
+		// ソースの編集後、編集箇所を含む外部宣言のみ再解析する
+		bool reparse(const char *source, int size, int edit_begin, int old_end, int new_end);
+
+		// 直前の再解析で字句解析したトークン数を取得
+		int getReparsedTokenNum(){return ReparsedTokenNum;}
+
 	private:
 		/**
 		 * 各種構文解析メソッド
 		 */
 		bool visitTranslationUnit();
-		bool visitExternalDeclaration(TranslationUnitAST *tunit);
-		PrototypeAST *visitFunctionDeclaration();
-		FunctionAST *visitFunctionDefinition();
+		bool visitTranslationUnitParallel();
+		bool visitExternalDeclaration(std::vector<DeclRange> &decls);
+		PrototypeAST *visitFunctionDeclaration(PrototypeAST *proto);
+		FunctionAST *visitFunctionDefinition(PrototypeAST *proto);
+		bool checkFunctionDefinition(PrototypeAST *proto);
 		PrototypeAST *visitPrototype();
 		FunctionStmtAST *visitFunctionStatement(PrototypeAST *proto);
 		VariableDeclAST *visitVariableDeclaration();
@@ -44,10 +124,25 @@ class Parser{
 		BaseAST *visitExpressionStatement();
 		BaseAST *visitJumpStatement();
 		BaseAST *visitAssignmentExpression();
-		BaseAST *visitAdditiveExpression(BaseAST *lhs);
-		BaseAST *visitMultiplicativeExpression(BaseAST *lhs);
+		BaseAST *visitBinaryExpression();
+		void reduceBinaryExpression();
 		BaseAST *visitPostfixExpression();
 		BaseAST *visitPrimaryExpression();
+
+		/**
+		 * 意味解析用メソッド
+		 */
+		int lookupPrototype(int symbol);
+		int lookupFunction(int symbol);
+		void addFunctionSymbol(SymbolTable<FunctionSymbol> &table, PrototypeAST *proto);
+		bool reparseAll(SourceBuffer *source);
+
+		/**
+		 * 並列構文解析用メソッド
+		 */
+		void addPrintnumPrototype();
+		bool skipFunctionBody();
+		void parseFunctionBodies(ParseChunk *chunk, const std::vector<BodyRange> *bodies);
 };
 
 #endif
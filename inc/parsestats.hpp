@@ -0,0 +1,110 @@
+#ifndef PARSESTATS_HPP
+#define PARSESTATS_HPP
+
+/**
+ * 構文解析の計測（DCC_PARSE_STATSを定義してビルドした場合のみ有効）
+ *
+ * 各visit*メソッドの先頭でPARSER_RULE(規則)を宣言し、
+ * 戻り値をPARSER_RESULT(値)で包むと（包まずに返した場合は失敗として数える）、規則ごとに
+ * 呼び出し回数、成功・失敗回数、巻き戻し回数、読み進めたトークン数、
+ * 巻き戻し後に読み直したトークン数、累積時間（入れ子の規則を含む）を記録する
+ * 定義しない場合はマクロが空になり、計測のコードは一切残らない
+ */
+#ifdef DCC_PARSE_STATS
+
+#include <cstdio>
+
+class TokenStream;
+
+/**
+ * 計測対象の構文規則
+ */
+enum ParseRule{
+	RULE_TRANSLATION_UNIT,
+	RULE_TRANSLATION_UNIT_PARALLEL,
+	RULE_EXTERNAL_DECLARATION,
+	RULE_FUNCTION_DECLARATION,
+	RULE_FUNCTION_DEFINITION,
+	RULE_PROTOTYPE,
+	RULE_FUNCTION_STATEMENT,
+	RULE_VARIABLE_DECLARATION,
+	RULE_STATEMENT,
+	RULE_EXPRESSION_STATEMENT,
+	RULE_JUMP_STATEMENT,
+	RULE_ASSIGNMENT_EXPRESSION,
+	RULE_BINARY_EXPRESSION,
+	RULE_POSTFIX_EXPRESSION,
+	RULE_PRIMARY_EXPRESSION,
+	RULE_NUM
+};
+
+/**
+ * 構文規則ごとの計測値
+ */
+struct ParseRuleStats{
+	long Calls;      // 呼び出し回数
+	long Successes;  // 成功回数
+	long Failures;   // 失敗回数
+	long Rewinds;    // 巻き戻し回数（applyTokenIndex, ungetToken）
+	long Consumed;   // 読み進めたトークン数
+	long Reconsumed; // 巻き戻し後に読み直したトークン数
+	double Time;     // 累積時間（秒）
+};
+
+/**
+ * 構文解析の計測値を保持するクラス
+ */
+class ParseStats{
+	private:
+		ParseRuleStats Rules[RULE_NUM];
+
+	public:
+		ParseStats();
+
+		// 構文規則の計測値を取得
+		ParseRuleStats &getRule(ParseRule rule){return Rules[rule];}
+
+		// 別の計測値を加算（並列構文解析の作業用Parserの集計）
+		void merge(const ParseStats &stats);
+
+		// 計測値を表形式で出力
+		void print(FILE *out);
+};
+
+/**
+ * 構文規則1回分の計測範囲
+ * 生成時に開始時点の値を記録し、破棄時に差分を加算する
+ */
+class ParseRuleScope{
+	private:
+		ParseRuleStats &Stats;
+		TokenStream *Tokens;
+		int MaxIndex;
+		int Reconsumed;
+		int Rewinds;
+		double Start;
+		bool Success;
+
+	public:
+		ParseRuleScope(ParseStats &stats, ParseRule rule, TokenStream *tokens);
+		~ParseRuleScope();
+
+		// 戻り値から成否を記録してそのまま返す
+		template<typename T>
+		T setResult(T result){
+			Success = result ? true : false;
+			return result;
+		}
+};
+
+#define PARSER_RULE(rule) ParseRuleScope parser_rule_scope(Stats, rule, Tokens)
+#define PARSER_RESULT(result) parser_rule_scope.setResult(result)
+
+#else
+
+#define PARSER_RULE(rule)
+#define PARSER_RESULT(result) (result)
+
+#endif
+
+#endif
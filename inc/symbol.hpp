@@ -0,0 +1,111 @@
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * 識別子の文字列を通し番号（シンボル番号）に対応付けるクラス
+ * 同じ文字列には常に同じ番号を返すため、以降は番号の比較のみで識別子を区別できる
+ * 開番地法のハッシュ表で検索する
+ */
+class StringInterner{
+	private:
+		std::deque<std::string> Strings;  // シンボル番号ごとの文字列（登録後も位置が変わらない）
+		std::vector<unsigned int> Hashes; // シンボル番号ごとのハッシュ値
+		std::vector<int> Buckets;         // シンボル番号（空きは-1、要素数は2の冪）
+
+	public:
+		StringInterner() : Buckets(64, -1){}
+
+		// 文字列のシンボル番号を取得（未登録の場合は登録する）
+		int intern(const char *str, int length);
+		int intern(const std::string &str){return intern(str.data(), str.size());}
+
+		// 登録済みの文字列のシンボル番号を取得（未登録の場合は-1）
+		int find(const char *str, int length);
+
+		// シンボル番号の文字列を取得（参照は以降の登録でも無効にならない）
+		const std::string &getString(int symbol){return Strings[symbol];}
+
+		// 登録済みの文字列の数を取得
+		int size(){return Strings.size();}
+
+		// 字句解析・構文解析で共有するStringInternerを取得
+		static StringInterner &getGlobal();
+
+	private:
+		int findBucket(const char *str, int length, unsigned int hash);
+		void rehash();
+};
+
+
+/**
+ * シンボル番号をキーとするスコープ付き記号表
+ * 各シンボルの最も内側の宣言をシンボル番号で直接引けるように保持し、
+ * 外側のスコープの宣言は内側の宣言を取り除いたときに戻す
+ */
+template<typename T>
+class SymbolTable{
+	private:
+		struct Entry{
+			int Symbol;
+			int Shadowed; // 同じシンボルの外側の宣言（無ければ-1）
+			T Value;
+		};
+		std::vector<int> Heads;       // シンボル番号ごとの最も内側の宣言（無ければ-1）
+		std::vector<Entry> Entries;   // 宣言順の要素
+		std::vector<int> ScopeBegins; // 各スコープの先頭要素
+
+	public:
+		SymbolTable(){ScopeBegins.push_back(0);}
+
+		// スコープを開始
+		void pushScope(){ScopeBegins.push_back(Entries.size());}
+
+		// 最も内側のスコープを終了し、そのスコープの宣言を取り除く
+		void popScope(){
+			int begin = ScopeBegins.back();
+			while(Entries.size() > begin){
+				Heads[Entries.back().Symbol] = Entries.back().Shadowed;
+				Entries.pop_back();
+			}
+			if(ScopeBegins.size() > 1)
+				ScopeBegins.pop_back();
+		}
+
+		// すべての宣言とスコープを取り除く
+		void clear(){
+			for(int i = 0; i < Entries.size(); i++)
+				Heads[Entries[i].Symbol] = -1;
+			Entries.clear();
+			ScopeBegins.resize(1);
+		}
+
+		// 最も内側のスコープに宣言を追加（外側の同名の宣言は隠れる）
+		T &insert(int symbol, const T &value){
+			if(symbol >= Heads.size())
+				Heads.resize(symbol + 1, -1);
+			Entry entry = {symbol, Heads[symbol], value};
+			Heads[symbol] = Entries.size();
+			Entries.push_back(entry);
+			return Entries.back().Value;
+		}
+
+		// 参照できる最も内側の宣言を検索（無ければNULL）
+		T *lookup(int symbol){
+			if(symbol < 0 || symbol >= Heads.size() || Heads[symbol] < 0)
+				return NULL;
+			return &Entries[Heads[symbol]].Value;
+		}
+
+		// 最も内側のスコープの宣言を検索（無ければNULL）
+		T *lookupCurrentScope(int symbol){
+			if(symbol < 0 || symbol >= Heads.size() || Heads[symbol] < ScopeBegins.back())
+				return NULL;
+			return &Entries[Heads[symbol]].Value;
+		}
+};
+
+#endif
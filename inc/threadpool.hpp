@@ -0,0 +1,46 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * スレッドプールクラス
+ * 追加されたタスクをワーカスレッドで順に実行する
+ */
+class ThreadPool{
+	private:
+		std::vector<std::thread> Workers;
+		std::deque<std::function<void()> > Tasks;
+		std::mutex Mutex;
+		std::condition_variable TaskCond; // タスク追加・終了要求の通知
+		std::condition_variable DoneCond; // 全タスク完了の通知
+		int Running;                      // 実行中のタスク数
+		bool Stop;
+
+	public:
+		// スレッド数に0を指定した場合はハードウェアのスレッド数
+		ThreadPool(int num_threads = 0);
+		~ThreadPool();
+
+		// タスクを追加
+		void addTask(const std::function<void()> &task);
+
+		// 追加したタスクがすべて完了するまで待つ
+		void wait();
+
+		// ワーカスレッド数を取得
+		int getNumThreads(){return Workers.size();}
+
+		// ハードウェアのスレッド数を取得
+		static int getHardwareThreads();
+
+	private:
+		void workerLoop();
+};
+
+#endif
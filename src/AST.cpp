@@ -1,17 +1,31 @@
+#include <type_traits>
 #include "AST.hpp"
-/*
- * デストラクタ
+
+// ASTはArenaの破棄時にデストラクタを呼ばずに解放するため、デストラクタを持たないこと
+static_assert(std::is_trivially_destructible<PrototypeAST>::value &&
+		std::is_trivially_destructible<FunctionAST>::value &&
+		std::is_trivially_destructible<FunctionStmtAST>::value &&
+		std::is_trivially_destructible<VariableDeclAST>::value &&
+		std::is_trivially_destructible<BinaryExprAST>::value &&
+		std::is_trivially_destructible<NullExprAST>::value &&
+		std::is_trivially_destructible<CallExprAST>::value &&
+		std::is_trivially_destructible<JumpStmtAST>::value &&
+		std::is_trivially_destructible<VariableAST>::value &&
+		std::is_trivially_destructible<NumberAST>::value,
+		"AST nodes must be trivially destructible");
+
+/**
+ * 二項演算子の文字列表現（BinaryOpの順）
  */
-TranslationUnitAST::~TranslationUnitAST(){
-	for(int i = 0; i < Prototypes.size(); i++){
-		SAFE_DELETE(Prototypes[i]);
-	}
-	Prototypes.clear();
+static const char *BinaryOpStrings[BINOP_NUM] = {"=", "+", "-", "*", "/"};
 
-	for(int i = 0; i < Functions.size(); i++){
-		SAFE_DELETE(Functions[i]);
-	}
-	Functions.clear();
+/**
+ * 二項演算子の文字列表現を取得する
+ * @param 二項演算子
+ * @return 文字列表現
+ */
+const char *getBinaryOpString(BinaryOp op){
+	return BinaryOpStrings[op];
 }
 
 /**
@@ -34,35 +48,62 @@ bool TranslationUnitAST::addFunction(FunctionAST *func){
 	return true;
 }
 
-bool TranslationUnitAST::empty(){
-	if(Prototypes.size() == 0 && Functions.size() == 0){
-		return true;
-	}else{
+/*
+ * PrototypeAST（関数宣言置き換え）メソッド
+ * @param 位置, PrototypeAST
+ * @return 成功時:true 失敗時:false
+ */
+bool TranslationUnitAST::replacePrototype(int i, PrototypeAST *proto){
+	if(i >= Prototypes.size())
 		return false;
-	}
+	Prototypes[i] = proto;
+	return true;
 }
 
-/**
- * デストラクタ
+/*
+ * FunctionAST（関数定義置き換え）メソッド
+ * @param 位置, FunctionAST
+ * @return 成功時:true 失敗時:false
  */
-FunctionAST::~FunctionAST(){
-	SAFE_DELETE(Proto);
-	SAFE_DELETE(Body);
+bool TranslationUnitAST::replaceFunction(int i, FunctionAST *func){
+	if(i >= Functions.size())
+		return false;
+	Functions[i] = func;
+	return true;
 }
 
 /*
- * デストラクタ
+ * FunctionAST（関数定義削除）メソッド
+ * @param 関数ごとの取り除くか
  */
-FunctionStmtAST::~FunctionStmtAST(){
-	for(int i = 0; i < VariableDecls.size(); i++){
-		SAFE_DELETE(VariableDecls[i]);
+void TranslationUnitAST::removeFunctions(const std::vector<bool> &removed){
+	int num = 0;
+	for(int i = 0; i < Functions.size(); i++){
+		if(i < removed.size() && removed[i])
+			continue;
+		Functions[num++] = Functions[i];
 	}
-	VariableDecls.clear();
+	Functions.resize(num);
+}
 
-	for(int i = 0; i < StmtLists.size(); i++){
-		SAFE_DELETE(StmtLists[i]);
+bool TranslationUnitAST::empty(){
+	if(Prototypes.size() == 0 && Functions.size() == 0){
+		return true;
+	}else{
+		return false;
 	}
-	StmtLists.clear();
+}
+
+/**
+ * コンストラクタ
+ * 引数名のリストはArenaにコピーする
+ * @param 確保先のArena, 関数名のシンボル番号, 引数名のシンボル番号のリスト
+ */
+PrototypeAST::PrototypeAST(Arena &arena, int name, const std::vector<int> &params)
+	: Name(name), ParamNum(params.size()){
+	Params = (int*)arena.allocate(sizeof(int) * ParamNum);
+	for(int i = 0; i < ParamNum; i++)
+		Params[i] = params[i];
 }
 
 /*
@@ -75,12 +116,14 @@ bool FunctionStmtAST::addVariableDeclaration(VariableDeclAST *vdecl){
 	return true;
 }
 
-/*
- * デストラクタ
+/**
+ * コンストラクタ
+ * 引数のリストはArenaにコピーする
+ * @param 確保先のArena, 関数名のシンボル番号, 引数のリスト
  */
-CallExprAST::~CallExprAST(){
-	for(int i = 0;i < Args.size(); i++){
-		SAFE_DELETE(Args[i]);
-	}
+CallExprAST::CallExprAST(Arena &arena, int callee, std::vector<BaseAST*> &args)
+	: BaseAST(CallExprID), Callee(callee), ArgNum(args.size()){
+	Args = (BaseAST**)arena.allocate(sizeof(BaseAST*) * ArgNum);
+	for(int i = 0; i < ArgNum; i++)
+		Args[i] = args[i];
 }
-
@@ -0,0 +1,60 @@
+#include <cstdio>
+#include <cstdlib>
+#include "arena.hpp"
+
+/**
+ * ブロックの標準の大きさ（これより大きい要求は専用のブロックを確保する）
+ */
+static const size_t BlockSize = 64 * 1024;
+
+/**
+ * デストラクタ
+ * 確保したオブジェクトのデストラクタは呼ばずにブロックをまとめて解放する
+ */
+Arena::~Arena(){
+	for(int i = 0; i < Blocks.size(); i++)
+		free(Blocks[i]);
+}
+
+/**
+ * 現在のブロックに収まらない場合の確保
+ * 標準の大きさを超える要求は専用のブロックに確保し、現在のブロックはそのまま使い続ける
+ * @param バイト数（境界に揃え済み）
+ * @return 確保した領域
+ */
+void *Arena::allocateSlow(size_t size){
+	if(size > BlockSize / 4){
+		char *block = (char*)malloc(size);
+		if(!block){
+			fprintf(stderr, "error::failed to allocate %lu bytes\n", (unsigned long)size);
+			exit(1);
+		}
+		Blocks.push_back(block);
+		return block;
+	}
+
+	char *block = (char*)malloc(BlockSize);
+	if(!block){
+		fprintf(stderr, "error::failed to allocate %lu bytes\n", (unsigned long)BlockSize);
+		exit(1);
+	}
+	Blocks.push_back(block);
+	Cur = block + size;
+	End = block + BlockSize;
+	return block;
+}
+
+/**
+ * 別のArenaのブロックを引き取る
+ * 並列構文解析の作業用Arenaを解析結果と共にTranslationUnitASTへ移すために使う
+ * 現在のブロックは引き取った後もこちらのものを使い続ける
+ * @param 引き取るArena（空になる）
+ */
+void Arena::adopt(Arena &arena){
+	Blocks.insert(Blocks.end(), arena.Blocks.begin(), arena.Blocks.end());
+	AllocatedNum += arena.AllocatedNum;
+	AllocatedBytes += arena.AllocatedBytes;
+	arena.Blocks.clear();
+	arena.Cur = arena.End = NULL;
+	arena.AllocatedNum = arena.AllocatedBytes = 0;
+}
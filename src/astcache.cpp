@@ -0,0 +1,249 @@
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "APP.hpp"
+#include "astcache.hpp"
+#include "lexer.hpp"
+
+/**
+ * キャッシュファイルの形式のバージョン（形式を変えたら上げる）
+ */
+static const unsigned int ASTCacheVersion = 1;
+
+/**
+ * FNV-1aの初期値と乗数
+ */
+static const unsigned long long FNVOffset = 14695981039346656037ULL;
+static const unsigned long long FNVPrime = 1099511628211ULL;
+
+/**
+ * バイト列のハッシュ値を求める
+ * FNV-1aを8バイト単位にしたもの（乗算で下位に伝わらない上位ビットは毎回折り返す）
+ * @param 先頭, バイト数, 前回までのハッシュ値（初回はFNVOffset）
+ * @return ハッシュ値
+ */
+unsigned long long ASTCache::computeHash(const char *data, size_t size, unsigned long long hash){
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8){
+		unsigned long long word;
+		memcpy(&word, data + i, 8);
+		hash = (hash ^ word) * FNVPrime;
+		hash ^= hash >> 32;
+	}
+	for(; i < size; i++)
+		hash = (hash ^ (unsigned char)data[i]) * FNVPrime;
+	return hash;
+}
+
+/**
+ * バイト列のハッシュ値を求める
+ * @param 先頭, バイト数
+ * @return ハッシュ値
+ */
+unsigned long long ASTCache::computeHash(const char *data, size_t size){
+	return computeHash(data, size, FNVOffset);
+}
+
+/**
+ * ソースファイルを読んでキーとキャッシュファイル名を求める
+ * キーはソースの内容、コンパイラのバージョン、ASTを変えるオプションのハッシュ値
+ * @param ソースファイル名, ASTを変えるオプション
+ * @return 成功時:true 失敗時:false
+ */
+bool ASTCache::open(const std::string &source_file, const std::string &options){
+	SourceBuffer *source = SourceBuffer::open(source_file);
+	if(!source)
+		return false;
+	Key = computeHash(source->getBegin(), source->getSize());
+	Key = computeHash(DCC_VERSION, strlen(DCC_VERSION), Key);
+	Key = computeHash(options.data(), options.size(), Key);
+	SourceSize = source->getSize();
+	SAFE_DELETE(source);
+
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.dca", Key);
+	FileName = Dir + name;
+	return true;
+}
+
+/**
+ * キャッシュから読み込む
+ * @param 読み込み先
+ * @return 成功時:true 失敗時:false（読み込み先は空になる）
+ */
+bool ASTCache::load(FlatAST &flat){
+	if(FileName.empty())
+		return false;
+	SourceBuffer *file = SourceBuffer::open(FileName);
+	if(!file)
+		return false;
+	bool loaded = read(file->getBegin(), file->getSize(), flat);
+	SAFE_DELETE(file);
+	if(!loaded)
+		flat.clear();
+	return loaded;
+}
+
+/**
+ * キャッシュファイルの内容を読み込む
+ * 先頭の検査の後、配列を写してシンボル番号を登録し直し、全体を検査する
+ * @param 内容の先頭, バイト数, 読み込み先
+ * @return 成功時:true 失敗時:false
+ */
+bool ASTCache::read(const char *data, size_t size, FlatAST &flat){
+	ASTCacheHeader header;
+	if(size < sizeof(header))
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if(memcmp(header.Magic, "DCCA", 4) != 0 || header.Version != ASTCacheVersion ||
+			header.Key != Key || header.SourceSize != SourceSize)
+		return false;
+
+	unsigned long long expected = sizeof(header) +
+		(unsigned long long)header.NodeNum * sizeof(FlatNode) +
+		(unsigned long long)header.StmtNum * sizeof(unsigned int) +
+		(unsigned long long)header.VarNum * sizeof(int) +
+		((unsigned long long)header.PrototypeNum + header.FunctionNum) * sizeof(FlatFunction) +
+		((unsigned long long)header.StringNum + 1) * sizeof(unsigned int) +
+		header.StringBytes;
+	if(expected != size)
+		return false;
+
+	const FlatNode *nodes = (const FlatNode*)(data + sizeof(header));
+	const unsigned int *stmts = (const unsigned int*)(nodes + header.NodeNum);
+	const int *vars = (const int*)(stmts + header.StmtNum);
+	const FlatFunction *protos = (const FlatFunction*)(vars + header.VarNum);
+	const FlatFunction *funcs = protos + header.PrototypeNum;
+	const unsigned int *offsets = (const unsigned int*)(funcs + header.FunctionNum);
+	const char *strings = (const char*)(offsets + header.StringNum + 1);
+
+	// 文字列を登録し直し、ファイル内の通し番号からシンボル番号への表を作る
+	if(offsets[0] != 0 || offsets[header.StringNum] != header.StringBytes)
+		return false;
+	StringInterner &interner = StringInterner::getGlobal();
+	std::vector<int> symbols(header.StringNum);
+	for(int i = 0; i < header.StringNum; i++){
+		if(offsets[i] > offsets[i + 1] || offsets[i + 1] > header.StringBytes)
+			return false;
+		symbols[i] = interner.intern(strings + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	flat.clear();
+	flat.Nodes.assign(nodes, nodes + header.NodeNum);
+	flat.Stmts.assign(stmts, stmts + header.StmtNum);
+	flat.Vars.assign(vars, vars + header.VarNum);
+	flat.Prototypes.assign(protos, protos + header.PrototypeNum);
+	flat.Functions.assign(funcs, funcs + header.FunctionNum);
+
+	for(int i = 0; i < flat.Nodes.size(); i++){
+		FlatNode &node = flat.Nodes[i];
+		if(node.Kind == FLAT_VARIABLE || node.Kind == FLAT_ASSIGN || node.Kind == FLAT_CALL){
+			if(node.Value < 0 || node.Value >= header.StringNum)
+				return false;
+			node.Value = symbols[node.Value];
+		}
+	}
+	for(int i = 0; i < flat.Vars.size(); i++){
+		if(flat.Vars[i] < 0 || flat.Vars[i] >= header.StringNum)
+			return false;
+		flat.Vars[i] = symbols[flat.Vars[i]];
+	}
+	for(int i = 0; i < flat.Prototypes.size() + flat.Functions.size(); i++){
+		FlatFunction &func = i < flat.Prototypes.size() ?
+			flat.Prototypes[i] : flat.Functions[i - flat.Prototypes.size()];
+		if(func.Name < 0 || func.Name >= header.StringNum)
+			return false;
+		func.Name = symbols[func.Name];
+	}
+	return flat.verify();
+}
+
+/**
+ * シンボル番号にファイル内の通し番号を割り当てる
+ * @param シンボル番号, シンボル番号から通し番号への表, 通し番号からシンボル番号への表
+ * @return 通し番号
+ */
+int ASTCache::addSymbol(int symbol, std::vector<int> &local, std::vector<int> &symbols){
+	if(local[symbol] < 0){
+		local[symbol] = symbols.size();
+		symbols.push_back(symbol);
+	}
+	return local[symbol];
+}
+
+/**
+ * キャッシュに書き込む
+ * 書きかけのファイルを読まないように、一時ファイルに書いてから名前を変える
+ * @param 書き込む内容
+ * @return 成功時:true 失敗時:false
+ */
+bool ASTCache::store(FlatAST &flat){
+	if(FileName.empty())
+		return false;
+	mkdir(Dir.c_str(), 0777);
+
+	// シンボル番号をファイル内の通し番号に付け替える
+	std::vector<int> local(StringInterner::getGlobal().size(), -1);
+	std::vector<int> symbols;
+	std::vector<FlatNode> nodes(flat.Nodes);
+	std::vector<int> vars(flat.Vars);
+	std::vector<FlatFunction> protos(flat.Prototypes);
+	std::vector<FlatFunction> funcs(flat.Functions);
+	for(int i = 0; i < nodes.size(); i++){
+		FlatNode &node = nodes[i];
+		if(node.Kind == FLAT_VARIABLE || node.Kind == FLAT_ASSIGN || node.Kind == FLAT_CALL)
+			node.Value = addSymbol(node.Value, local, symbols);
+	}
+	for(int i = 0; i < vars.size(); i++)
+		vars[i] = addSymbol(vars[i], local, symbols);
+	for(int i = 0; i < protos.size(); i++)
+		protos[i].Name = addSymbol(protos[i].Name, local, symbols);
+	for(int i = 0; i < funcs.size(); i++)
+		funcs[i].Name = addSymbol(funcs[i].Name, local, symbols);
+
+	StringInterner &interner = StringInterner::getGlobal();
+	std::vector<unsigned int> offsets(1, 0);
+	std::string strings;
+	for(int i = 0; i < symbols.size(); i++){
+		strings += interner.getString(symbols[i]);
+		offsets.push_back(strings.size());
+	}
+
+	ASTCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, "DCCA", 4);
+	header.Version = ASTCacheVersion;
+	header.Key = Key;
+	header.SourceSize = SourceSize;
+	header.NodeNum = nodes.size();
+	header.StmtNum = flat.Stmts.size();
+	header.VarNum = vars.size();
+	header.PrototypeNum = protos.size();
+	header.FunctionNum = funcs.size();
+	header.StringNum = symbols.size();
+	header.StringBytes = strings.size();
+
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+	std::string tmp_name = FileName + suffix;
+	FILE *fp = fopen(tmp_name.c_str(), "wb");
+	if(!fp)
+		return false;
+	bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(nodes.data(), sizeof(FlatNode), nodes.size(), fp) == nodes.size() &&
+		fwrite(flat.Stmts.data(), sizeof(unsigned int), flat.Stmts.size(), fp) == flat.Stmts.size() &&
+		fwrite(vars.data(), sizeof(int), vars.size(), fp) == vars.size() &&
+		fwrite(protos.data(), sizeof(FlatFunction), protos.size(), fp) == protos.size() &&
+		fwrite(funcs.data(), sizeof(FlatFunction), funcs.size(), fp) == funcs.size() &&
+		fwrite(offsets.data(), sizeof(unsigned int), offsets.size(), fp) == offsets.size() &&
+		fwrite(strings.data(), 1, strings.size(), fp) == strings.size();
+	if(fclose(fp) != 0)
+		written = false;
+	if(!written || rename(tmp_name.c_str(), FileName.c_str()) != 0){
+		unlink(tmp_name.c_str());
+		return false;
+	}
+	return true;
+}
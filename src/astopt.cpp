@@ -0,0 +1,180 @@
+#include <climits>
+#include "astopt.hpp"
+
+/**
+ * TranslationUnitASTの全関数の式を書き換える
+ * @param 書き換えるTranslationUnitAST
+ */
+void ConstantFolder::fold(TranslationUnitAST &tunit){
+	Nodes = &tunit.getArena();
+	for(int i = 0; FunctionAST *func = tunit.getFunction(i); i++){
+		FunctionStmtAST *body = func->getBody();
+		for(int j = 0; BaseAST *stmt = body->getStatement(j); j++){
+			Depth = 0;
+			body->setStatement(j, foldExpression(stmt));
+		}
+	}
+}
+
+/**
+ * 定数同士の二項演算の結果を求める
+ * 加減乗算は符号無し整数で計算して32bitで折り返し、
+ * 除算は0での除算とINT_MIN / -1（いずれも実行時には未定義）を畳み込まない
+ * @param 演算子, 左辺, 右辺, 結果の格納先
+ * @return 畳み込めた場合:true 畳み込めない場合:false
+ */
+bool ConstantFolder::evaluate(BinaryOp op, int lhs, int rhs, int &result){
+	unsigned int l = lhs;
+	unsigned int r = rhs;
+	switch(op){
+		case BINOP_ADD:
+			result = (int)(l + r);
+			return true;
+		case BINOP_SUB:
+			result = (int)(l - r);
+			return true;
+		case BINOP_MUL:
+			result = (int)(l * r);
+			return true;
+		case BINOP_DIV:
+			if(rhs == 0 || (lhs == INT_MIN && rhs == -1))
+				return false;
+			result = lhs / rhs;
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * 式を書き換える
+ * 深さがMaxExpressionDepthを超えた部分木は副作用を持つものとしてそのまま返す
+ * @param 式
+ * @return 書き換えた式
+ */
+BaseAST *ConstantFolder::foldExpression(BaseAST *expr){
+	if(Depth >= MaxExpressionDepth){
+		Pure = false;
+		return expr;
+	}
+	Depth++;
+	BaseAST *folded = visit(expr);
+	Depth--;
+	return folded;
+}
+
+/**
+ * 二項演算を書き換える
+ * 両辺を先に書き換え、両辺が定数なら畳み込み、そうでなければ恒等式で簡約する
+ * 代入は右辺のみ書き換える
+ * @param BinaryExprAST
+ * @return 書き換えた式
+ */
+BaseAST *ConstantFolder::visitBinaryExpr(BinaryExprAST *bin_expr){
+	if(bin_expr->getOp() == BINOP_ASSIGN){
+		bin_expr->setRHS(foldExpression(bin_expr->getRHS()));
+		Pure = false;
+		return bin_expr;
+	}
+
+	bin_expr->setLHS(foldExpression(bin_expr->getLHS()));
+	bool lhs_pure = Pure;
+	bin_expr->setRHS(foldExpression(bin_expr->getRHS()));
+	bool rhs_pure = Pure;
+	Pure = lhs_pure && rhs_pure;
+
+	NumberAST *lhs_num = llvm::dyn_cast<NumberAST>(bin_expr->getLHS());
+	NumberAST *rhs_num = llvm::dyn_cast<NumberAST>(bin_expr->getRHS());
+	if(lhs_num && rhs_num){
+		int result;
+		if(!evaluate(bin_expr->getOp(), lhs_num->getNumberValue(), rhs_num->getNumberValue(), result))
+			return bin_expr;
+		FoldedNum++;
+		return new (*Nodes) NumberAST(result);
+	}
+	return simplify(bin_expr, lhs_pure, rhs_pure);
+}
+
+/**
+ * 片方が定数の二項演算を恒等式で簡約する
+ * x+0, 0+x, x-0, x*1, 1*x, x/1 はxに、x*0, 0*x はxが副作用を持たない場合のみ0にする
+ * @param 両辺を書き換え済みのBinaryExprAST, 左辺・右辺が副作用を持たないか
+ * @return 簡約した式（簡約できない場合は元の式）
+ */
+BaseAST *ConstantFolder::simplify(BinaryExprAST *bin_expr, bool lhs_pure, bool rhs_pure){
+	BaseAST *lhs = bin_expr->getLHS();
+	BaseAST *rhs = bin_expr->getRHS();
+	NumberAST *lhs_num = llvm::dyn_cast<NumberAST>(lhs);
+	NumberAST *rhs_num = llvm::dyn_cast<NumberAST>(rhs);
+	if(!lhs_num && !rhs_num)
+		return bin_expr;
+	int lhs_val = lhs_num ? lhs_num->getNumberValue() : 0;
+	int rhs_val = rhs_num ? rhs_num->getNumberValue() : 0;
+
+	BaseAST *simplified = NULL;
+	switch(bin_expr->getOp()){
+		case BINOP_ADD:
+			if(rhs_num && rhs_val == 0)
+				simplified = lhs;
+			else if(lhs_num && lhs_val == 0)
+				simplified = rhs;
+			break;
+		case BINOP_SUB:
+			if(rhs_num && rhs_val == 0)
+				simplified = lhs;
+			break;
+		case BINOP_MUL:
+			if(rhs_num && rhs_val == 1)
+				simplified = lhs;
+			else if(lhs_num && lhs_val == 1)
+				simplified = rhs;
+			else if(rhs_num && rhs_val == 0 && lhs_pure)
+				simplified = rhs;
+			else if(lhs_num && lhs_val == 0 && rhs_pure)
+				simplified = lhs;
+			break;
+		case BINOP_DIV:
+			if(rhs_num && rhs_val == 1)
+				simplified = lhs;
+			break;
+		default:
+			break;
+	}
+	if(!simplified)
+		return bin_expr;
+	SimplifiedNum++;
+	return simplified;
+}
+
+/**
+ * 関数呼び出しの引数を書き換える
+ * @param CallExprAST
+ * @return 元の式
+ */
+BaseAST *ConstantFolder::visitCallExpr(CallExprAST *call_expr){
+	for(int i = 0; i < call_expr->getArgNum(); i++)
+		call_expr->setArgs(i, foldExpression(call_expr->getArgs(i)));
+	Pure = false;
+	return call_expr;
+}
+
+/**
+ * returnで返す式を書き換える
+ * @param JumpStmtAST
+ * @return 元の文
+ */
+BaseAST *ConstantFolder::visitJumpStmt(JumpStmtAST *jump_stmt){
+	jump_stmt->setExpr(foldExpression(jump_stmt->getExpr()));
+	Pure = false;
+	return jump_stmt;
+}
+
+/**
+ * 数値・変数参照など子を持たないAST
+ * @param BaseAST
+ * @return 元のAST
+ */
+BaseAST *ConstantFolder::visitBase(BaseAST *ast){
+	Pure = true;
+	return ast;
+}
@@ -0,0 +1,263 @@
+#include <cstring>
+#include "charscan.hpp"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define CHARSCAN_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * 文字種別テーブル（CharClassの論理和）
+ */
+const unsigned char CharClassTable[256] = {
+	0,0,0,0,0,0,0,0,0,4,4,4,4,4,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	4,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	2,2,2,2,2,2,2,2,2,2,0,0,0,0,0,0,
+	0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+	1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,
+	0,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+	1,1,1,1,1,1,1,1,1,1,1,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
+};
+
+/*
+ * スカラー実装
+ */
+static const char *scanAlnumScalar(const char *cur, const char *end){
+	while(cur < end && (CharClassTable[(unsigned char)*cur] & (CC_ALPHA | CC_DIGIT)))
+		cur++;
+	return cur;
+}
+
+static const char *scanDigitScalar(const char *cur, const char *end){
+	while(cur < end && isDigitChar(*cur))
+		cur++;
+	return cur;
+}
+
+static const char *scanSpaceScalar(const char *cur, const char *end, int *lines){
+	while(cur < end && isSpaceChar(*cur)){
+		if(*cur == '\n')
+			(*lines)++;
+		cur++;
+	}
+	return cur;
+}
+
+static const char *scanCommentEndScalar(const char *cur, const char *end, int *lines){
+	while(cur + 1 < end && !(cur[0] == '*' && cur[1] == '/')){
+		if(*cur == '\n')
+			(*lines)++;
+		cur++;
+	}
+	if(cur + 1 >= end){
+		if(cur < end && *cur == '\n')
+			(*lines)++;
+		return end;
+	}
+	return cur;
+}
+
+#ifdef CHARSCAN_X86
+/*
+ * SSE2実装（16バイト単位）
+ * 符号なし範囲比較 lo <= c < lo+n は、c+(0x80-lo) < -128+n の符号付き比較で行う
+ */
+#define SSE_RANGE(v, lo, n) \
+	_mm_cmplt_epi8(_mm_add_epi8((v), _mm_set1_epi8((char)(0x80 - (lo)))), \
+	               _mm_set1_epi8((char)(0x80 + (n))))
+
+static inline __m128i sseAlnumMask(__m128i v){
+	__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	return _mm_or_si128(SSE_RANGE(lower, 'a', 26), SSE_RANGE(v, '0', 10));
+}
+
+static inline __m128i sseSpaceMask(__m128i v){
+	return _mm_or_si128(SSE_RANGE(v, '\t', 5), _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+static const char *scanAlnumSSE2(const char *cur, const char *end){
+	for(; cur + 16 <= end; cur += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)cur);
+		unsigned mask = ~_mm_movemask_epi8(sseAlnumMask(v)) & 0xffff;
+		if(mask)
+			return cur + __builtin_ctz(mask);
+	}
+	return scanAlnumScalar(cur, end);
+}
+
+static const char *scanDigitSSE2(const char *cur, const char *end){
+	for(; cur + 16 <= end; cur += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)cur);
+		unsigned mask = ~_mm_movemask_epi8(SSE_RANGE(v, '0', 10)) & 0xffff;
+		if(mask)
+			return cur + __builtin_ctz(mask);
+	}
+	return scanDigitScalar(cur, end);
+}
+
+static const char *scanSpaceSSE2(const char *cur, const char *end, int *lines){
+	const __m128i newline = _mm_set1_epi8('\n');
+	for(; cur + 16 <= end; cur += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)cur);
+		unsigned mask = ~_mm_movemask_epi8(sseSpaceMask(v)) & 0xffff;
+		unsigned nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+		if(mask){
+			unsigned stop = __builtin_ctz(mask);
+			*lines += __builtin_popcount(nl & ((1u << stop) - 1));
+			return cur + stop;
+		}
+		*lines += __builtin_popcount(nl);
+	}
+	return scanSpaceScalar(cur, end, lines);
+}
+
+static const char *scanCommentEndSSE2(const char *cur, const char *end, int *lines){
+	const __m128i star = _mm_set1_epi8('*');
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i newline = _mm_set1_epi8('\n');
+	for(; cur + 17 <= end; cur += 16){
+		__m128i v = _mm_loadu_si128((const __m128i*)cur);
+		__m128i next = _mm_loadu_si128((const __m128i*)(cur + 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(v, star), _mm_cmpeq_epi8(next, slash)));
+		unsigned nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+		if(mask){
+			unsigned stop = __builtin_ctz(mask);
+			*lines += __builtin_popcount(nl & ((1u << stop) - 1));
+			return cur + stop;
+		}
+		*lines += __builtin_popcount(nl);
+	}
+	return scanCommentEndScalar(cur, end, lines);
+}
+
+/*
+ * AVX2実装（32バイト単位）
+ */
+#define AVX_RANGE(v, lo, n) \
+	_mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (n))), \
+	                  _mm256_add_epi8((v), _mm256_set1_epi8((char)(0x80 - (lo)))))
+
+__attribute__((target("avx2")))
+static const char *scanAlnumAVX2(const char *cur, const char *end){
+	for(; cur + 32 <= end; cur += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)cur);
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i in = _mm256_or_si256(AVX_RANGE(lower, 'a', 26), AVX_RANGE(v, '0', 10));
+		unsigned mask = ~(unsigned)_mm256_movemask_epi8(in);
+		if(mask)
+			return cur + __builtin_ctz(mask);
+	}
+	return scanAlnumSSE2(cur, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanDigitAVX2(const char *cur, const char *end){
+	for(; cur + 32 <= end; cur += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)cur);
+		unsigned mask = ~(unsigned)_mm256_movemask_epi8(AVX_RANGE(v, '0', 10));
+		if(mask)
+			return cur + __builtin_ctz(mask);
+	}
+	return scanDigitSSE2(cur, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanSpaceAVX2(const char *cur, const char *end, int *lines){
+	const __m256i newline = _mm256_set1_epi8('\n');
+	for(; cur + 32 <= end; cur += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)cur);
+		__m256i in = _mm256_or_si256(AVX_RANGE(v, '\t', 5),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+		unsigned mask = ~(unsigned)_mm256_movemask_epi8(in);
+		unsigned nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+		if(mask){
+			unsigned stop = __builtin_ctz(mask);
+			*lines += __builtin_popcount(nl & ((1u << stop) - 1));
+			return cur + stop;
+		}
+		*lines += __builtin_popcount(nl);
+	}
+	return scanSpaceSSE2(cur, end, lines);
+}
+
+__attribute__((target("avx2")))
+static const char *scanCommentEndAVX2(const char *cur, const char *end, int *lines){
+	const __m256i star = _mm256_set1_epi8('*');
+	const __m256i slash = _mm256_set1_epi8('/');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	for(; cur + 33 <= end; cur += 32){
+		__m256i v = _mm256_loadu_si256((const __m256i*)cur);
+		__m256i next = _mm256_loadu_si256((const __m256i*)(cur + 1));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(v, star), _mm256_cmpeq_epi8(next, slash)));
+		unsigned nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline));
+		if(mask){
+			unsigned stop = __builtin_ctz(mask);
+			*lines += __builtin_popcount(nl & ((1u << stop) - 1));
+			return cur + stop;
+		}
+		*lines += __builtin_popcount(nl);
+	}
+	return scanCommentEndSSE2(cur, end, lines);
+}
+#endif
+
+/**
+ * 走査関数の実装テーブル
+ */
+struct ScanKernels{
+	const char *Name;
+	const char *(*Alnum)(const char*, const char*);
+	const char *(*Digit)(const char*, const char*);
+	const char *(*Space)(const char*, const char*, int*);
+	const char *(*CommentEnd)(const char*, const char*, int*);
+};
+
+/**
+ * CPUに合わせて実装を選択する（初回呼び出し時に1度だけ判定）
+ */
+static const ScanKernels &getScanKernels(){
+#ifdef CHARSCAN_X86
+	static const ScanKernels avx2 = {"avx2",
+		scanAlnumAVX2, scanDigitAVX2, scanSpaceAVX2, scanCommentEndAVX2};
+	static const ScanKernels sse2 = {"sse2",
+		scanAlnumSSE2, scanDigitSSE2, scanSpaceSSE2, scanCommentEndSSE2};
+	static const ScanKernels &selected =
+		__builtin_cpu_supports("avx2") ? avx2 : sse2;
+	return selected;
+#else
+	static const ScanKernels scalar = {"scalar",
+		scanAlnumScalar, scanDigitScalar, scanSpaceScalar, scanCommentEndScalar};
+	return scalar;
+#endif
+}
+
+const char *scanAlnum(const char *cur, const char *end){
+	return getScanKernels().Alnum(cur, end);
+}
+
+const char *scanDigit(const char *cur, const char *end){
+	return getScanKernels().Digit(cur, end);
+}
+
+const char *scanSpace(const char *cur, const char *end, int *lines){
+	return getScanKernels().Space(cur, end, lines);
+}
+
+const char *scanCommentEnd(const char *cur, const char *end, int *lines){
+	return getScanKernels().CommentEnd(cur, end, lines);
+}
+
+const char *getScanKernelName(){
+	return getScanKernels().Name;
+}
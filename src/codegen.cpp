@@ -2,10 +2,12 @@
 
 /**
  * コンストラクタ
+ * @param 引数・変数をallocaを使わずSSAの値として生成するか
  */
-CodeGen::CodeGen(){
+CodeGen::CodeGen(bool with_ssa){
 	Builder = new llvm::IRBuilder<>(llvm::getGlobalContext());
 	Mod = NULL;
+	WithSSA = with_ssa;
 }
 
 /**
@@ -25,7 +27,27 @@ bool CodeGen::doCodeGen(TranslationUnitAST &tunit, std::string name, std::string
 	// Module生成に失敗したら終了
 	if(!generateTranslationUnit(tunit, name))
 		return false;
-	
+	return finishModule(link_file, with_jit);
+}
+
+/**
+ * 平坦化したASTからのコード生成実行
+ * @param FlatAST Module名（入力ファイル名）
+ * @return 成功時:true 失敗時:false
+ */
+bool CodeGen::doCodeGen(FlatAST &flat, std::string name, std::string link_file, bool with_jit){
+	// Module生成に失敗したら終了
+	if(!generateTranslationUnit(flat, name))
+		return false;
+	return finishModule(link_file, with_jit);
+}
+
+/**
+ * 生成したModuleのリンク・JIT実行
+ * @param リンクするファイル名, JIT実行するか
+ * @return 成功時:true 失敗時:false
+ */
+bool CodeGen::finishModule(std::string link_file, bool with_jit){
 	// LinkFileの指定があったらModuleをリンク
 	if(!link_file.empty() && !linkModule(Mod, link_file))
 		return false;
@@ -67,6 +89,7 @@ llvm::Module &CodeGen::getModule(){
 bool CodeGen::generateTranslationUnit(TranslationUnitAST &tunit, std::string name){
 	// Moduleを生成
 	Mod = new llvm::Module(name, llvm::getGlobalContext());
+	FunctionTable.clear();
 	
 	// function declaration
 	for(int i = 0; ; i++){
@@ -92,25 +115,66 @@ bool CodeGen::generateTranslationUnit(TranslationUnitAST &tunit, std::string nam
 	return true;
 }
 
+/**
+ *  平坦化したASTからのModule生成メソッド
+ *  @param FlatAST Module名（入力ファイル）
+ *  @return 成功時:true 失敗時:false
+ */
+bool CodeGen::generateTranslationUnit(FlatAST &flat, std::string name){
+	// Moduleを生成
+	Mod = new llvm::Module(name, llvm::getGlobalContext());
+	FunctionTable.clear();
+
+	// function declaration
+	for(int i = 0; i < flat.getPrototypeNum(); i++){
+		const FlatFunction &proto = flat.getPrototype(i);
+		if(!declareFunction(proto.Name, flat.getVars(proto.VarBegin), proto.ParamNum, Mod)){
+			SAFE_DELETE(Mod);
+			return false;
+		}
+	}
+
+	// function definition
+	for(int i = 0; i < flat.getFunctionNum(); i++){
+		if(!generateFunctionDefinition(flat, flat.getFunction(i), Mod)){
+			SAFE_DELETE(Mod);
+			return false;
+		}
+	}
+	return true;
+}
+
 /**
  * 関数宣言生成メソッド
  * @param PrototypeAST, Module
  * @return 生成したFunctionのポインタ
  */
 llvm::Function *CodeGen::generatePrototype(PrototypeAST *proto, llvm::Module *mod){
+	return declareFunction(proto->getSymbol(), proto->getParamSymbols(), proto->getParamNum(), mod);
+}
+
+/**
+ * 関数宣言生成（宣言済みなら引数の数を確認してそのまま返す）
+ * @param 関数名のシンボル番号, 引数名のシンボル番号の配列, 引数の数, Module
+ * @return 生成したFunctionのポインタ
+ */
+llvm::Function *CodeGen::declareFunction(int name, const int *params, int param_num, llvm::Module *mod){
+	StringInterner &strings = StringInterner::getGlobal();
+
 	// already declared?
-	llvm::Function *func = mod->getFunction(proto->getName());
+	llvm::Function **declared = FunctionTable.lookup(name);
+	llvm::Function *func = declared ? *declared : NULL;
 	if(func){
-		if(func->arg_size() == proto->getParamNum() && func->empty()){
+		if(func->arg_size() == param_num && func->empty()){
 			return func;
 		}else{
-			fprintf(stderr, "error::function %s is redefined", proto->getName().c_str());
+			fprintf(stderr, "error::function %s is redefined", strings.getString(name).c_str());
 			return NULL;
 		}
 	}
 
 	// create arg_types
-	std::vector<llvm::Type*> int_types(proto->getParamNum(), 
+	std::vector<llvm::Type*> int_types(param_num, 
 			llvm::Type::getInt32Ty(llvm::getGlobalContext()));
 
 	// create func type
@@ -118,18 +182,38 @@ llvm::Function *CodeGen::generatePrototype(PrototypeAST *proto, llvm::Module *mo
 		(llvm::Type::getInt32Ty(llvm::getGlobalContext()),int_types,false);
 
 	// create function
-	func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, proto->getName(), mod);
+	func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, strings.getString(name), mod);
+	FunctionTable.insert(name, func);
 
 	// set names
 	llvm::Function::arg_iterator arg_iter = func->arg_begin();
-	for(int i = 0; i < proto->getParamNum(); i++){
-		arg_iter->setName(proto->getParamName(i).append("_arg"));
+	for(int i = 0; i < param_num; i++){
+		arg_iter->setName(strings.getString(params[i]) + "_arg");
 		arg_iter++;
 	}
 
 	return func;
 }
 
+/**
+ * 関数本体の生成開始
+ * 引数を変数表に登録し（引数のallocaを生成すると置き換わる）、entryブロックを生成する
+ * @param Function, 引数名のシンボル番号の配列, 引数の数
+ */
+void CodeGen::beginFunction(llvm::Function *func, const int *params, int param_num){
+	CurFunc = func;
+
+	VariableTable.clear();
+	llvm::Function::arg_iterator arg_iter = func->arg_begin();
+	for(int i = 0; i < param_num; i++){
+		VariableTable.insert(params[i], &*arg_iter);
+		arg_iter++;
+	}
+
+	llvm::BasicBlock *bblock = llvm::BasicBlock::Create(llvm::getGlobalContext(), "entry", func);
+	Builder->SetInsertPoint(bblock);
+}
+
 /**
  * 関数定義生成メソッド
  * @param FunctionAST Module
@@ -140,14 +224,42 @@ llvm::Function *CodeGen::generateFunctionDefinition(FunctionAST *func_ast, llvm:
 	if(!func){
 		return NULL;
 	}
-	CurFunc = func;
-	llvm::BasicBlock *bblock = llvm::BasicBlock::Create(llvm::getGlobalContext(), "entry", func);
-	Builder->SetInsertPoint(bblock);
+	PrototypeAST *proto = func_ast->getPrototype();
+	beginFunction(func, proto->getParamSymbols(), proto->getParamNum());
+
 	// Functionのボディを生成
 	generateFunctionStatement(func_ast->getBody());
 	return func;
 }
 
+/**
+ * 平坦化したASTからの関数定義生成メソッド
+ * 変数宣言の後、各文のノードを先頭から順に値のスタックを使って生成する
+ * @param FlatAST, 関数定義, Module
+ * @return 生成したFunctionのポインタ
+ */
+llvm::Function *CodeGen::generateFunctionDefinition(FlatAST &flat, const FlatFunction &flat_func, llvm::Module *mod){
+	const int *params = flat.getVars(flat_func.VarBegin);
+	llvm::Function *func = declareFunction(flat_func.Name, params, flat_func.ParamNum, mod);
+	if(!func){
+		return NULL;
+	}
+	beginFunction(func, params, flat_func.ParamNum);
+
+	// 変数表の先頭ParamNum個は引数
+	for(int i = 0; i < flat_func.VarNum; i++)
+		generateVariableDeclaration(flat.getVar(flat_func.VarBegin + i), i < flat_func.ParamNum);
+
+	unsigned int node = flat_func.NodeBegin;
+	for(int i = 0; i < flat_func.StmtNum; i++){
+		unsigned int root = flat.getStmt(flat_func.StmtBegin + i);
+		for(; node <= root; node++)
+			generateFlatNode(flat.getNode(node));
+		ValueStack.clear();
+	}
+	return func;
+}
+
 /**
  * 関数生成メソッド
  * 変数宣言、ステートメントの順に生成
@@ -156,7 +268,6 @@ llvm::Function *CodeGen::generateFunctionDefinition(FunctionAST *func_ast, llvm:
  */
 llvm::Value *CodeGen::generateFunctionStatement(FunctionStmtAST *func_stmt){
 	// inser variable decls
-	VariableDeclAST *vdecl;
 	llvm::Value *v = NULL;
 	for(int i = 0; ;i++){
 		// 最後まで見たら終了
@@ -164,8 +275,7 @@ llvm::Value *CodeGen::generateFunctionStatement(FunctionStmtAST *func_stmt){
 			break;
 
 		//create alloca
-		vdecl = llvm::dyn_cast<VariableDeclAST>(func_stmt->getVariableDecl(i));
-		v = generateVariableDeclaration(vdecl);
+		v = visitVariableDecl(func_stmt->getVariableDecl(i));
 	}
 
 	// insert expr statement
@@ -175,8 +285,8 @@ llvm::Value *CodeGen::generateFunctionStatement(FunctionStmtAST *func_stmt){
 		stmt = func_stmt->getStatement(i);
 		if(!stmt)
 			break;
-		else if(!llvm::isa<NullExprAST>(stmt))
-			v = generateStatement(stmt);
+		else if(stmt->getValueID() != NullExprID)
+			v = visit(stmt);
 	}
 	return v;
 }
@@ -186,109 +296,156 @@ llvm::Value *CodeGen::generateFunctionStatement(FunctionStmtAST *func_stmt){
  * @param VariableDeclAST
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateVariableDeclaration(VariableDeclAST *vdecl){
+llvm::Value *CodeGen::visitVariableDecl(VariableDeclAST *vdecl){
+	return generateVariableDeclaration(vdecl->getSymbol(), vdecl->getType() == VariableDeclAST::param);
+}
+
+/**
+ * 変数宣言(alloca命令)生成メソッド
+ * SSAの場合は命令を生成せず、引数は引数の値、ローカル変数は不定値を最初の定義とする
+ * @param 変数名のシンボル番号, 引数か
+ * @return 生成したValueのポインタ
+ */
+llvm::Value *CodeGen::generateVariableDeclaration(int symbol, bool is_param){
+	if(WithSSA){
+		if(is_param)
+			return *VariableTable.lookup(symbol);
+		return VariableTable.insert(symbol,
+				llvm::UndefValue::get(llvm::Type::getInt32Ty(llvm::getGlobalContext())));
+	}
+
 	// create alloca
 	llvm::AllocaInst *alloca = Builder->CreateAlloca(
-			llvm::Type::getInt32Ty(llvm::getGlobalContext()), 0, vdecl->getName());
+			llvm::Type::getInt32Ty(llvm::getGlobalContext()), 0,
+			StringInterner::getGlobal().getString(symbol));
 
 	// if args alloca
-	if(vdecl->getType() == VariableDeclAST::param){
+	if(is_param){
 		// store args
-		llvm::ValueSymbolTable &vs_table = CurFunc->getValueSymbolTable();
-		Builder->CreateStore(vs_table.lookup(vdecl->getName().append("_arg")),alloca);
+		Builder->CreateStore(*VariableTable.lookup(symbol),alloca);
 	}
+	VariableTable.insert(symbol, alloca);
 	return alloca;
 }
 
 /**
- * ステートメント生成メソッド
- * 実際にはASTの種類を確認して各種生成メソッドを呼び出し
- * @param JumpStmtAST
+ * 変数参照生成メソッド
+ * SSAの場合は現在の定義をそのまま返す（load命令は生成しない）
+ * @param 変数名のシンボル番号
+ * @return 変数の値
+ */
+llvm::Value *CodeGen::readVariable(int symbol){
+	if(WithSSA)
+		return *VariableTable.lookup(symbol);
+	return Builder->CreateLoad(*VariableTable.lookup(symbol), "var_temp");
+}
+
+/**
+ * 変数への代入生成メソッド
+ * SSAの場合は代入した値を変数の現在の定義とする（store命令は生成しない）
+ * @param 変数名のシンボル番号, 代入する値
+ */
+void CodeGen::writeVariable(int symbol, llvm::Value *value){
+	if(WithSSA)
+		*VariableTable.lookup(symbol) = value;
+	else
+		generateBinaryOperation(BINOP_ASSIGN, *VariableTable.lookup(symbol), value);
+}
+
+/**
+ * 平坦化したASTのノード生成メソッド
+ * 子の値は値のスタックから取り出し、生成した値をスタックに積む
+ * @param FlatNode
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateStatement(BaseAST *stmt){
-	if(llvm::isa<BinaryExprAST>(stmt)){
-		return generateBinaryExpression(llvm::dyn_cast<BinaryExprAST>(stmt));
-	}else if(llvm::isa<CallExprAST>(stmt)){
-		return generateCallExpression(llvm::dyn_cast<CallExprAST>(stmt));
-	}else if(llvm::isa<JumpStmtAST>(stmt)){
-		return generateJumpStatement(llvm::dyn_cast<JumpStmtAST>(stmt));
-	}else{
-		return NULL;
+llvm::Value *CodeGen::generateFlatNode(const FlatNode &node){
+	llvm::Value *v = NULL;
+	switch(node.Kind){
+		case FLAT_NUMBER:
+			v = generateNumber(node.Value);
+			break;
+		case FLAT_VARIABLE:
+			v = readVariable(node.Value);
+			break;
+		case FLAT_BINARY:{
+			llvm::Value *rhs_v = ValueStack.back();
+			ValueStack.pop_back();
+			llvm::Value *lhs_v = ValueStack.back();
+			ValueStack.pop_back();
+			v = generateBinaryOperation((BinaryOp)node.Op, lhs_v, rhs_v);
+			break;
+		}
+		case FLAT_ASSIGN:
+			// 代入式の値は右辺の値
+			v = ValueStack.back();
+			ValueStack.pop_back();
+			writeVariable(node.Value, v);
+			break;
+		case FLAT_CALL:{
+			std::vector<llvm::Value*> arg_vec(ValueStack.end() - node.Count, ValueStack.end());
+			ValueStack.resize(ValueStack.size() - node.Count);
+			v = Builder->CreateCall(*FunctionTable.lookup(node.Value), arg_vec, "call_temp");
+			break;
+		}
+		case FLAT_RETURN:
+			v = ValueStack.back();
+			ValueStack.pop_back();
+			Builder->CreateRet(v);
+			break;
+		default:
+			break;
 	}
+	ValueStack.push_back(v);
+	return v;
 }
 
 /**
  * 二項演算生成メソッド
- * @param JumpStmtAST
+ * 代入式の値は右辺の値（store命令ではない）
+ * @param BinaryExprAST
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateBinaryExpression(BinaryExprAST *bin_expr){
-	BaseAST *lhs = bin_expr->getLHS();
-	BaseAST *rhs = bin_expr->getRHS();
-
-	llvm::Value *lhs_v;
-	llvm::Value *rhs_v;
-
+llvm::Value *CodeGen::visitBinaryExpr(BinaryExprAST *bin_expr){
 	// assignment
-	if(bin_expr->getOp() == "="){
+	if(bin_expr->getOp() == BINOP_ASSIGN){
 		// lhs is variable
-		VariableAST *lhs_var = llvm::dyn_cast<VariableAST>(lhs);
-		llvm::ValueSymbolTable &vs_table = CurFunc->getValueSymbolTable();
-		lhs_v = vs_table.lookup(lhs_var->getName());
-	
-	// other operand
-	}else{
-		// lhs = ?
-		// Binary?
-		if(llvm::isa<BinaryExprAST>(lhs)){
-			lhs_v = generateBinaryExpression(llvm::dyn_cast<BinaryExprAST>(lhs));
-
-		// Variable?
-		}else if(llvm::isa<VariableAST>(lhs)){
-			lhs_v = generateVariable(llvm::dyn_cast<VariableAST>(lhs));
-
-		// Variable?
-		}else if(llvm::isa<NumberAST>(lhs)){
-			NumberAST *num = llvm::dyn_cast<NumberAST>(lhs);
-			lhs_v = generateNumber(num->getNumberValue());
-		}
+		VariableAST *lhs_var = llvm::cast<VariableAST>(bin_expr->getLHS());
+		llvm::Value *rhs_v = visit(bin_expr->getRHS());
+		writeVariable(lhs_var->getSymbol(), rhs_v);
+		return rhs_v;
 	}
 
+	// other operand
+	llvm::Value *lhs_v = visit(bin_expr->getLHS());
+	llvm::Value *rhs_v = visit(bin_expr->getRHS());
+	return generateBinaryOperation(bin_expr->getOp(), lhs_v, rhs_v);
+}
 
-	// create rhs value
-	if(llvm::isa<BinaryExprAST>(rhs)){
-		rhs_v = generateBinaryExpression(llvm::dyn_cast<BinaryExprAST>(rhs));
-	
-	// CallExpr?
-	}else if(llvm::isa<CallExprAST>(rhs)){
-		rhs_v = generateCallExpression(llvm::dyn_cast<CallExprAST>(rhs));
-	
-	// Variable?
-	}else if(llvm::isa<VariableAST>(rhs)){
-		rhs_v = generateVariable(llvm::dyn_cast<VariableAST>(rhs));
-
-	// Number?
-	}else if(llvm::isa<NumberAST>(rhs)){
-		NumberAST *num = llvm::dyn_cast<NumberAST>(rhs);
-		rhs_v = generateNumber(num->getNumberValue());
-	}
-
-	if(bin_expr->getOp() == "="){
-		// store
-		return Builder->CreateStore(rhs_v, lhs_v);
-	}else if(bin_expr->getOp() == "+"){
-		// add
-		return Builder->CreateAdd(rhs_v, lhs_v, "add_tmp");
-	}else if(bin_expr->getOp() == "-"){
-		// sub
-		return Builder->CreateSub(lhs_v, rhs_v, "sub_tmp");
-	}else if(bin_expr->getOp() == "*"){
-		// mul
-		return Builder->CreateMul(lhs_v, rhs_v, "mul_tmp");
-	}else if(bin_expr->getOp() == "/"){
-		// div
-		return Builder->CreateSDiv(lhs_v, rhs_v,"div_temp");
+/**
+ * 二項演算の命令生成
+ * 代入の場合は左辺に変数のallocaを渡す
+ * @param 演算子, 左辺の値, 右辺の値
+ * @return 生成したValueのポインタ
+ */
+llvm::Value *CodeGen::generateBinaryOperation(BinaryOp op, llvm::Value *lhs_v, llvm::Value *rhs_v){
+	switch(op){
+		case BINOP_ASSIGN:
+			// store
+			return Builder->CreateStore(rhs_v, lhs_v);
+		case BINOP_ADD:
+			// add
+			return Builder->CreateAdd(rhs_v, lhs_v, "add_tmp");
+		case BINOP_SUB:
+			// sub
+			return Builder->CreateSub(lhs_v, rhs_v, "sub_tmp");
+		case BINOP_MUL:
+			// mul
+			return Builder->CreateMul(lhs_v, rhs_v, "mul_tmp");
+		case BINOP_DIV:
+			// div
+			return Builder->CreateSDiv(lhs_v, rhs_v,"div_temp");
+		default:
+			return NULL;
 	}
 }
 
@@ -297,42 +454,11 @@ llvm::Value *CodeGen::generateBinaryExpression(BinaryExprAST *bin_expr){
  * @param CallExprAST
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateCallExpression(CallExprAST *call_expr){
+llvm::Value *CodeGen::visitCallExpr(CallExprAST *call_expr){
 	std::vector<llvm::Value*> arg_vec;
-	BaseAST *arg;
-	llvm::Value *arg_v;
-	llvm::ValueSymbolTable &vs_table = CurFunc->getValueSymbolTable();
-
-	for(int i = 0; ;i++){
-		if(!(arg = call_expr->getArgs(i)))
-			break;
-
-		// isCall
-		if(llvm::isa<CallExprAST>(arg))
-			arg_v = generateCallExpression(llvm::dyn_cast<CallExprAST>(arg));
-
-		// isBinaryExpr
-		else if(llvm::isa<BinaryExprAST>(arg)){
-			BinaryExprAST *bin_expr = llvm::dyn_cast<BinaryExprAST>(arg);
-			arg_v = generateBinaryExpression(llvm::dyn_cast<BinaryExprAST>(arg));
-			if(bin_expr->getOp() == "="){
-				VariableAST *var = llvm::dyn_cast<VariableAST>(bin_expr->getLHS());
-				arg_v = Builder->CreateLoad(vs_table.lookup(var->getName()), "arg_val");
-			}
-		}
-
-		// isVar
-		else if(llvm::isa<VariableAST>(arg))
-			arg_v = generateVariable(llvm::dyn_cast<VariableAST>(arg));
-
-		// isNumber
-		else if(llvm::isa<NumberAST>(arg)){
-			NumberAST *num = llvm::dyn_cast<NumberAST>(arg);
-			arg_v = generateNumber(num->getNumberValue());
-		}
-		arg_vec.push_back(arg_v);
-	}
-	return Builder->CreateCall(Mod->getFunction(call_expr->getCallee()), arg_vec, "call_temp");
+	for(int i = 0; i < call_expr->getArgNum(); i++)
+		arg_vec.push_back(visit(call_expr->getArgs(i)));
+	return Builder->CreateCall(*FunctionTable.lookup(call_expr->getCalleeSymbol()), arg_vec, "call_temp");
 }
 
 /**
@@ -340,19 +466,8 @@ llvm::Value *CodeGen::generateCallExpression(CallExprAST *call_expr){
  * @param JumpStmtAST
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateJumpStatement(JumpStmtAST *jump_stmt){
-	BaseAST *expr = jump_stmt->getExpr();
-	llvm::Value *ret_v;
-	if(llvm::isa<BinaryExprAST>(expr)){
-		ret_v = generateBinaryExpression(llvm::dyn_cast<BinaryExprAST>(expr));
-	}else if(llvm::isa<VariableAST>(expr)){
-		VariableAST *var = llvm::dyn_cast<VariableAST>(expr);
-		ret_v = generateVariable(var);
-	}else if(llvm::isa<NumberAST>(expr)){
-		NumberAST *num = llvm::dyn_cast<NumberAST>(expr);
-		ret_v = generateNumber(num->getNumberValue());
-
-	}
+llvm::Value *CodeGen::visitJumpStmt(JumpStmtAST *jump_stmt){
+	llvm::Value *ret_v = visit(jump_stmt->getExpr());
 	if(!ret_v)
 		return NULL;
 	else{
@@ -366,9 +481,17 @@ llvm::Value *CodeGen::generateJumpStatement(JumpStmtAST *jump_stmt){
  * @param VariableAST
  * @return 生成したValueのポインタ
  */
-llvm::Value *CodeGen::generateVariable(VariableAST *var){
-	llvm::ValueSymbolTable &vs_table = CurFunc->getValueSymbolTable();
-	return Builder->CreateLoad(vs_table.lookup(var->getName()), "var_temp");
+llvm::Value *CodeGen::visitVariable(VariableAST *var){
+	return readVariable(var->getSymbol());
+}
+
+/**
+ * 定数生成メソッド
+ * @param NumberAST
+ * @return 生成したValueのポインタ
+ */
+llvm::Value *CodeGen::visitNumber(NumberAST *num){
+	return generateNumber(num->getNumberValue());
 }
 
 /**
@@ -13,6 +13,12 @@
 #include "APP.hpp"
 #include "parser.hpp"
 #include "codegen.hpp"
+#include "flatast.hpp"
+#include "astcache.hpp"
+#include "astopt.hpp"
+#include "funceval.hpp"
+#include "funcdce.hpp"
+#include "funcmerge.hpp"
 
 /**
  * オプション切り出しクラス
@@ -22,17 +28,32 @@ class OptionParser{
 		std::string InputFileName;
 		std::string OutputFileName;
 		std::string LinkFileName;
+		std::string ASTCacheDir;
+		std::vector<std::string> RootNames;
 		bool WithJit;
+		bool WithFlatAST;
+		bool WithASTOpt;
+		bool WithSSA;
+		LexMode Mode;
+		ParseMode PMode;
 		int Argc;
 		char **Argv;
 	
 	public:
-		OptionParser(int argc, char **argv) : Argc(argc), Argv(argv),WithJit(false){}
+		OptionParser(int argc, char **argv) : Argc(argc), Argv(argv),WithJit(false),WithFlatAST(false),WithASTOpt(true),WithSSA(false),Mode(LEX_BATCH),PMode(PARSE_SERIAL){}
 		void printHelp();
 		std::string getInputFileName(){return InputFileName;} // 入力ファイル名出力
 		std::string getOutputFileName(){return OutputFileName;} // 出力ファイル名取得
 		std::string getLinkFileName(){return LinkFileName;} // リンク用ファイル名取得
 		bool getWithJit(){return WithJit;} // JIT実行有無
+		bool getWithFlatAST(){return WithFlatAST;} // 平坦化したASTからコード生成するか
+		std::string getASTCacheDir(){return ASTCacheDir;} // ASTのキャッシュディレクトリ取得
+		const std::vector<std::string> &getRootNames(){return RootNames;} // main以外に残す関数名取得
+		bool getWithDCE(){return WithASTOpt && (LinkFileName.empty() || !RootNames.empty());} // 到達しない関数を削除するか
+		bool getWithASTOpt(){return WithASTOpt;} // AST上の定数畳み込み・定数伝播・不要な関数の削除・関数の統合を行うか
+		bool getWithSSA(){return WithSSA;} // allocaを使わずSSAで直接コード生成するか（mem2regを行わない）
+		LexMode getLexMode(){return Mode;} // 字句解析の方式
+		ParseMode getParseMode(){return PMode;} // 構文解析の方式
 		bool parseOption();
 };
 
@@ -73,6 +94,41 @@ bool OptionParser::parseOption(){
 			       	Argv[i][2] == 'i' && Argv[i][3] == 't' && Argv[i][4] == '\0'){
 			WithJit = true;
 		}
+		// -stream トークンを構文解析の要求に応じて切り出す
+		else if(strcmp(Argv[i], "-stream") == 0){
+			Mode = LEX_STREAM;
+		}
+		// -parallel-lex ファイルを分割して複数スレッドで字句解析する
+		else if(strcmp(Argv[i], "-parallel-lex") == 0){
+			Mode = LEX_PARALLEL;
+		}
+		// -parallel-parse 関数本体を複数スレッドで構文解析する
+		else if(strcmp(Argv[i], "-parallel-parse") == 0){
+			PMode = PARSE_PARALLEL;
+		}
+		// -flat-ast ASTを平坦化し、元のASTを解放してからコード生成する
+		else if(strcmp(Argv[i], "-flat-ast") == 0){
+			WithFlatAST = true;
+		}
+		// -ast-cache 平坦化したASTをソースの内容をキーとしてディレクトリにキャッシュする
+		else if(strcmp(Argv[i], "-ast-cache") == 0 && i + 1 < Argc){
+			ASTCacheDir.assign(Argv[++i]);
+			WithFlatAST = true;
+		}
+		// -root mainから呼ばれなくても残す関数名を追加する（ライブラリとしてビルドする場合）
+		// -lでリンクする場合は、-rootを指定しない限り関数を削除しない（リンク先から呼ばれうるため）
+		else if(strcmp(Argv[i], "-root") == 0 && i + 1 < Argc){
+			RootNames.push_back(Argv[++i]);
+		}
+		// -no-ast-opt AST上の定数畳み込み・代数的簡約、定数伝播・コンパイル時の関数呼び出しの評価、
+		// 到達しない関数の削除、構造の同じ関数の統合を行わない
+		else if(strcmp(Argv[i], "-no-ast-opt") == 0){
+			WithASTOpt = false;
+		}
+		// -ssa 引数・変数のallocaを作らずSSAの値として直接コード生成し、mem2regを省く
+		else if(strcmp(Argv[i], "-ssa") == 0){
+			WithSSA = true;
+		}
 		// -? 不明なオプション
 		else if(Argv[i][0] == '-'){
 			fprintf(stderr, "%s は不明なオプションです\n", Argv[i]);
@@ -118,26 +174,88 @@ int main(int argc, char **argv){
 		exit(1);
 	}
 
-	// lex and parse
-	Parser *parser = new Parser(opt.getInputFileName());
-	if(!parser->doParse()){
-		fprintf(stderr, "err at parser or lexer\n");
-		SAFE_DELETE(parser);
-		exit(1);
+	// load AST from cache
+	FlatAST flat;
+	ASTCache *cache = NULL;
+	bool cached = false;
+	if(!opt.getASTCacheDir().empty()){
+		std::string options;
+		if(opt.getWithASTOpt()){
+			options = "fold,eval";
+			if(opt.getWithDCE()){
+				options += ",dce";
+				for(int i = 0; i < opt.getRootNames().size(); i++)
+					options += ",root=" + opt.getRootNames()[i];
+			}
+			options += ",merge";
+		}
+		cache = new ASTCache(opt.getASTCacheDir());
+		if(cache->open(opt.getInputFileName(), options))
+			cached = cache->load(flat);
 	}
 
-	// get AST
-	TranslationUnitAST &tunit = parser->getAST();
-	if(tunit.empty()){
-		fprintf(stderr, "TranslationUnit is empty");
-		SAFE_DELETE(parser);
-		exit(1);
+	Parser *parser = NULL;
+	if(!cached){
+		// lex and parse
+		parser = new Parser(opt.getInputFileName(), opt.getLexMode());
+		if(!parser->doParse(opt.getParseMode())){
+			fprintf(stderr, "err at parser or lexer\n");
+			SAFE_DELETE(parser);
+			SAFE_DELETE(cache);
+			exit(1);
+		}
+
+		// get AST
+		if(parser->getAST().empty()){
+			fprintf(stderr, "TranslationUnit is empty");
+			SAFE_DELETE(parser);
+			SAFE_DELETE(cache);
+			exit(1);
+		}
+
+		// fold constants, evaluate constant calls, remove unreachable functions and merge identical functions
+		if(opt.getWithASTOpt()){
+			ConstantFolder folder;
+			folder.fold(parser->getAST());
+			ConstantPropagator propagator;
+			propagator.propagate(parser->getAST());
+			if(opt.getWithDCE()){
+				DeadFunctionEliminator eliminator;
+				for(int i = 0; i < opt.getRootNames().size(); i++)
+					eliminator.addRoot(opt.getRootNames()[i]);
+				eliminator.eliminate(parser->getAST());
+			}
+			FunctionMerger merger;
+			merger.merge(parser->getAST());
+		}
+
+		// flatten AST
+		if(opt.getWithFlatAST()){
+			if(!flat.build(parser->getAST())){
+				fprintf(stderr, "err at flattening AST\n");
+				SAFE_DELETE(parser);
+				SAFE_DELETE(cache);
+				exit(1);
+			}
+			SAFE_DELETE(parser);
+
+			// store AST to cache
+			if(cache && !cache->store(flat))
+				fprintf(stderr, "warning: failed to write AST cache %s\n", cache->getFileName().c_str());
+		}
 	}
+	SAFE_DELETE(cache);
 
 	// get AST
-	CodeGen *codegen = new CodeGen();
-	if(!codegen->doCodeGen(tunit, opt.getInputFileName(),
-			       	opt.getLinkFileName(), opt.getWithJit())){
+	CodeGen *codegen = new CodeGen(opt.getWithSSA());
+	bool generated;
+	if(opt.getWithFlatAST())
+		generated = codegen->doCodeGen(flat, opt.getInputFileName(),
+				opt.getLinkFileName(), opt.getWithJit());
+	else
+		generated = codegen->doCodeGen(parser->getAST(), opt.getInputFileName(),
+				opt.getLinkFileName(), opt.getWithJit());
+	if(!generated){
 		fprintf(stderr, "err at codegen\n");
 		SAFE_DELETE(parser);
 		SAFE_DELETE(codegen);
@@ -156,8 +274,9 @@ int main(int argc, char **argv){
 
 	llvm::PassManager pm;
 	
-	// mem2regをPassManagerに登録
-	pm.add(llvm::createPromoteMemoryToRegisterPass());
+	// mem2regをPassManagerに登録（SSAで生成した場合はallocaが無いため不要）
+	if(!opt.getWithSSA())
+		pm.add(llvm::createPromoteMemoryToRegisterPass());
 	
 	// 出力
 	std::string error;
@@ -0,0 +1,325 @@
+#include "flatast.hpp"
+
+/**
+ * TranslationUnitASTを平坦化する
+ * 関数宣言・関数定義の順序、文の順序、式の評価順（左辺、右辺、演算の順）は元のASTのまま
+ * 平坦化した後は作業領域を解放し、配列を必要な大きさに詰める
+ * @param 平坦化するTranslationUnitAST
+ * @return 成功時:true 失敗時:false（引数が多すぎる呼び出しがある）
+ */
+bool FlatAST::build(TranslationUnitAST &tunit){
+	clear();
+
+	for(int i = 0; PrototypeAST *proto = tunit.getPrototype(i); i++)
+		Prototypes.push_back(addPrototype(proto));
+
+	for(int i = 0; FunctionAST *func_ast = tunit.getFunction(i); i++){
+		FlatFunction func = addPrototype(func_ast->getPrototype());
+
+		// 変数表は関数本体の変数宣言（引数、ローカル変数の順）で置き換える
+		Vars.resize(func.VarBegin);
+		FunctionStmtAST *body = func_ast->getBody();
+		for(int j = 0; VariableDeclAST *vdecl = body->getVariableDecl(j); j++)
+			Vars.push_back(vdecl->getSymbol());
+		func.VarNum = Vars.size() - func.VarBegin;
+
+		for(int j = 0; BaseAST *stmt = body->getStatement(j); j++){
+			if(!addExpression(stmt, 0)){
+				clear();
+				return false;
+			}
+			Stmts.push_back(Nodes.size() - 1);
+		}
+		func.StmtNum = Stmts.size() - func.StmtBegin;
+		Functions.push_back(func);
+	}
+
+	std::vector<std::pair<BaseAST*, bool> >().swap(Pending);
+	std::vector<unsigned int>().swap(Roots);
+	std::vector<FlatNode>(Nodes).swap(Nodes);
+	std::vector<unsigned int>(Stmts).swap(Stmts);
+	std::vector<int>(Vars).swap(Vars);
+	return true;
+}
+
+/**
+ * 保持している内容をすべて破棄する
+ */
+void FlatAST::clear(){
+	Nodes.clear();
+	Stmts.clear();
+	Vars.clear();
+	Prototypes.clear();
+	Functions.clear();
+	Pending.clear();
+	Roots.clear();
+	Callees.clear();
+	Locals.clear();
+}
+
+/**
+ * 保持している内容を検査する
+ * 外部から読み込んだ内容をコード生成に渡す前に使う
+ * 変数は関数の変数表にあるもの、呼び出し先はコード生成の時点で宣言済みのもの
+ * （関数宣言、その関数定義自身と前にある関数定義）に限る
+ * @return 正しい場合:true 不正な場合:false
+ */
+bool FlatAST::verify(){
+	bool verified = verifyFunctions();
+	Roots.clear();
+	Callees.clear();
+	Locals.clear();
+	return verified;
+}
+
+/**
+ * 関数宣言・関数定義を順に検査する
+ * @return 正しい場合:true 不正な場合:false
+ */
+bool FlatAST::verifyFunctions(){
+	Callees.clear();
+	for(int i = 0; i < Prototypes.size() + Functions.size(); i++){
+		const FlatFunction &func = i < Prototypes.size() ? Prototypes[i] : Functions[i - Prototypes.size()];
+		if(func.ParamNum < 0 || func.VarNum < func.ParamNum || func.StmtNum < 0 ||
+				func.VarBegin < 0 || func.VarBegin > (long)Vars.size() - func.VarNum ||
+				func.StmtBegin < 0 || func.StmtBegin > (long)Stmts.size() - func.StmtNum ||
+				func.NodeBegin < 0 || func.NodeBegin > (long)Nodes.size())
+			return false;
+		Callees.insert(func.Name, func.ParamNum);
+		Locals.clear();
+		for(int j = 0; j < func.VarNum; j++)
+			Locals.insert(Vars[func.VarBegin + j], true);
+
+		// 各文のノードを部分木の根の位置をスタックに積みながら辿る
+		unsigned int node = func.NodeBegin;
+		for(int j = 0; j < func.StmtNum; j++){
+			unsigned int root = Stmts[func.StmtBegin + j];
+			if(root < node || root >= Nodes.size())
+				return false;
+			Roots.clear();
+			for(; node <= root; node++){
+				const FlatNode &flat_node = Nodes[node];
+				switch(flat_node.Kind){
+					case FLAT_NUMBER:
+						break;
+					case FLAT_NULL:
+						// 文の根にだけ置ける
+						if(node != root)
+							return false;
+						break;
+					case FLAT_VARIABLE:
+						if(!Locals.lookup(flat_node.Value))
+							return false;
+						break;
+					case FLAT_BINARY:
+						if(Roots.size() < 2 || flat_node.Op == BINOP_ASSIGN || flat_node.Op >= BINOP_NUM ||
+								Roots[Roots.size() - 2] != flat_node.Value)
+							return false;
+						Roots.resize(Roots.size() - 2);
+						break;
+					case FLAT_ASSIGN:
+						if(Roots.empty() || !Locals.lookup(flat_node.Value))
+							return false;
+						Roots.pop_back();
+						break;
+					case FLAT_RETURN:
+						if(node != root || Roots.empty())
+							return false;
+						Roots.pop_back();
+						break;
+					case FLAT_CALL:{
+						int *param_num = Callees.lookup(flat_node.Value);
+						if(Roots.size() < flat_node.Count || !param_num || *param_num != flat_node.Count)
+							return false;
+						Roots.resize(Roots.size() - flat_node.Count);
+						break;
+					}
+					default:
+						return false;
+				}
+				Roots.push_back(node);
+			}
+			if(Roots.size() != 1)
+				return false;
+		}
+		Roots.clear();
+	}
+	return true;
+}
+
+/**
+ * 保持しているデータのバイト数を取得する（平坦化用の作業領域は除く）
+ * @return バイト数
+ */
+size_t FlatAST::getMemorySize(){
+	return Nodes.capacity() * sizeof(FlatNode) +
+		Stmts.capacity() * sizeof(unsigned int) +
+		Vars.capacity() * sizeof(int) +
+		(Prototypes.capacity() + Functions.capacity()) * sizeof(FlatFunction);
+}
+
+/**
+ * 関数宣言を追加する
+ * 引数名を変数表に追加し、関数本体は空とする
+ * @param 関数宣言
+ * @return 平坦化した関数宣言
+ */
+FlatFunction FlatAST::addPrototype(PrototypeAST *proto){
+	FlatFunction func;
+	func.Name = proto->getSymbol();
+	func.ParamNum = proto->getParamNum();
+	func.VarBegin = Vars.size();
+	func.VarNum = func.ParamNum;
+	for(int i = 0; i < func.ParamNum; i++)
+		Vars.push_back(proto->getParamSymbol(i));
+	func.NodeBegin = Nodes.size();
+	func.StmtBegin = Stmts.size();
+	func.StmtNum = 0;
+	return func;
+}
+
+/**
+ * 文・式を後行順に追加する
+ * 深さがMaxExpressionDepthを超えた部分木はaddDeepExpressionで辿る
+ * @param 文・式の根, 深さ
+ * @return 成功時:true 失敗時:false
+ */
+bool FlatAST::addExpression(BaseAST *expr, int depth){
+	if(depth > MaxExpressionDepth)
+		return addDeepExpression(expr);
+
+	switch(expr->getValueID()){
+		case NumberID:
+			addNode(FLAT_NUMBER, 0, 0, llvm::cast<NumberAST>(expr)->getNumberValue());
+			return true;
+		case VariableID:
+			addNode(FLAT_VARIABLE, 0, 0, llvm::cast<VariableAST>(expr)->getSymbol());
+			return true;
+		case BinaryExprID:{
+			BinaryExprAST *bin_expr = llvm::cast<BinaryExprAST>(expr);
+			if(bin_expr->getOp() == BINOP_ASSIGN){
+				if(!addExpression(bin_expr->getRHS(), depth + 1))
+					return false;
+				addNode(FLAT_ASSIGN, 0, 0,
+						llvm::cast<VariableAST>(bin_expr->getLHS())->getSymbol());
+			}else{
+				if(!addExpression(bin_expr->getLHS(), depth + 1))
+					return false;
+				unsigned int lhs = Nodes.size() - 1;
+				if(!addExpression(bin_expr->getRHS(), depth + 1))
+					return false;
+				addNode(FLAT_BINARY, bin_expr->getOp(), 0, lhs);
+			}
+			return true;
+		}
+		case CallExprID:{
+			CallExprAST *call_expr = llvm::cast<CallExprAST>(expr);
+			if(call_expr->getArgNum() > FlatMaxArgNum)
+				return false;
+			for(int i = 0; i < call_expr->getArgNum(); i++)
+				if(!addExpression(call_expr->getArgs(i), depth + 1))
+					return false;
+			addNode(FLAT_CALL, 0, call_expr->getArgNum(), call_expr->getCalleeSymbol());
+			return true;
+		}
+		case JumpStmtID:
+			if(!addExpression(llvm::cast<JumpStmtAST>(expr)->getExpr(), depth + 1))
+				return false;
+			addNode(FLAT_RETURN, 0, 0, 0);
+			return true;
+		default:
+			addNode(FLAT_NULL, 0, 0, 0);
+			return true;
+	}
+}
+
+/**
+ * 深い部分木を後行順に追加する（再帰せずに作業用のスタックで辿る）
+ * Pendingには未出力のノードと子を積み終えたかを積み、Rootsには出力した部分木の根の位置を積む
+ * @param 部分木の根
+ * @return 成功時:true 失敗時:false
+ */
+bool FlatAST::addDeepExpression(BaseAST *expr){
+	Pending.push_back(std::make_pair(expr, false));
+	while(!Pending.empty()){
+		BaseAST *node = Pending.back().first;
+		bool expanded = Pending.back().second;
+		Pending.pop_back();
+
+		// 子を持つノードは積み直し、その上に右の子、左の子の順に積んで子を先に出力する
+		if(!expanded){
+			int size = Pending.size();
+			Pending.push_back(std::make_pair(node, true));
+			if(BinaryExprAST *bin_expr = llvm::dyn_cast<BinaryExprAST>(node)){
+				Pending.push_back(std::make_pair(bin_expr->getRHS(), false));
+				if(bin_expr->getOp() != BINOP_ASSIGN)
+					Pending.push_back(std::make_pair(bin_expr->getLHS(), false));
+			}else if(CallExprAST *call_expr = llvm::dyn_cast<CallExprAST>(node)){
+				for(int i = call_expr->getArgNum() - 1; i >= 0; i--)
+					Pending.push_back(std::make_pair(call_expr->getArgs(i), false));
+			}else if(JumpStmtAST *jump_stmt = llvm::dyn_cast<JumpStmtAST>(node)){
+				Pending.push_back(std::make_pair(jump_stmt->getExpr(), false));
+			}
+			if(Pending.size() > size + 1)
+				continue;
+			Pending.pop_back();
+		}
+
+		switch(node->getValueID()){
+			case NumberID:
+				addNode(FLAT_NUMBER, 0, 0, llvm::cast<NumberAST>(node)->getNumberValue());
+				break;
+			case VariableID:
+				addNode(FLAT_VARIABLE, 0, 0, llvm::cast<VariableAST>(node)->getSymbol());
+				break;
+			case BinaryExprID:{
+				BinaryExprAST *bin_expr = llvm::cast<BinaryExprAST>(node);
+				if(bin_expr->getOp() == BINOP_ASSIGN){
+					Roots.pop_back();
+					addNode(FLAT_ASSIGN, 0, 0,
+							llvm::cast<VariableAST>(bin_expr->getLHS())->getSymbol());
+				}else{
+					Roots.pop_back();
+					unsigned int lhs = Roots.back();
+					Roots.pop_back();
+					addNode(FLAT_BINARY, bin_expr->getOp(), 0, lhs);
+				}
+				break;
+			}
+			case CallExprID:{
+				CallExprAST *call_expr = llvm::cast<CallExprAST>(node);
+				if(call_expr->getArgNum() > FlatMaxArgNum){
+					Pending.clear();
+					Roots.clear();
+					return false;
+				}
+				Roots.resize(Roots.size() - call_expr->getArgNum());
+				addNode(FLAT_CALL, 0, call_expr->getArgNum(), call_expr->getCalleeSymbol());
+				break;
+			}
+			case JumpStmtID:
+				Roots.pop_back();
+				addNode(FLAT_RETURN, 0, 0, 0);
+				break;
+			default:
+				addNode(FLAT_NULL, 0, 0, 0);
+				break;
+		}
+		Roots.push_back(Nodes.size() - 1);
+	}
+	Roots.clear();
+	return true;
+}
+
+/**
+ * ノードを末尾に追加する
+ * @param 種類, 演算子, 引数の数, 値（数値・シンボル番号・左辺の根の位置）
+ */
+void FlatAST::addNode(FlatKind kind, int op, int count, int value){
+	FlatNode node;
+	node.Kind = kind;
+	node.Op = op;
+	node.Count = count;
+	node.Value = value;
+	Nodes.push_back(node);
+}
@@ -0,0 +1,93 @@
+#include "funcdce.hpp"
+
+/**
+ * 到達しない関数定義を取り除く
+ * 起点の関数定義から作業リストで関数呼び出しを辿り、到達しなかったものをまとめて取り除く
+ * @param TranslationUnitAST
+ * @return 起点の関数が定義されている場合:true 定義されていない場合:false
+ */
+bool DeadFunctionEliminator::eliminate(TranslationUnitAST &tunit){
+	Functions.clear();
+	Worklist.clear();
+	RemovedNum = 0;
+	FunctionNum = 0;
+	while(tunit.getFunction(FunctionNum))
+		FunctionNum++;
+	Reachable.assign(FunctionNum, false);
+
+	for(int i = 0; i < FunctionNum; i++)
+		Functions.insert(tunit.getFunction(i)->getPrototype()->getSymbol(), i);
+
+	StringInterner &strings = StringInterner::getGlobal();
+	bool rooted = markReachable(strings.find("main", 4));
+	for(int i = 0; i < RootNames.size(); i++)
+		if(markReachable(strings.find(RootNames[i].data(), RootNames[i].size())))
+			rooted = true;
+	if(!rooted)
+		return false;
+
+	while(!Worklist.empty()){
+		FunctionStmtAST *body = tunit.getFunction(Worklist.back())->getBody();
+		Worklist.pop_back();
+		for(int i = 0; BaseAST *stmt = body->getStatement(i); i++){
+			Pending.push_back(stmt);
+			while(!Pending.empty()){
+				BaseAST *node = Pending.back();
+				Pending.pop_back();
+				visit(node);
+			}
+		}
+	}
+
+	std::vector<bool> removed(FunctionNum);
+	for(int i = 0; i < FunctionNum; i++){
+		removed[i] = !Reachable[i];
+		if(removed[i])
+			RemovedNum++;
+	}
+	tunit.removeFunctions(removed);
+	return true;
+}
+
+/**
+ * 関数定義に到達したものとし、未到達なら作業リストに追加する
+ * @param 関数名のシンボル番号（定義の無い関数・未登録の名前は無視する）
+ * @return 関数定義がある場合:true 無い場合:false
+ */
+bool DeadFunctionEliminator::markReachable(int symbol){
+	int *index = Functions.lookup(symbol);
+	if(!index)
+		return false;
+	if(!Reachable[*index]){
+		Reachable[*index] = true;
+		Worklist.push_back(*index);
+	}
+	return true;
+}
+
+/**
+ * 二項演算の両辺を辿る
+ * @param BinaryExprAST
+ */
+void DeadFunctionEliminator::visitBinaryExpr(BinaryExprAST *bin_expr){
+	Pending.push_back(bin_expr->getRHS());
+	Pending.push_back(bin_expr->getLHS());
+}
+
+/**
+ * 呼び出し先を到達したものとし、引数を辿る
+ * @param CallExprAST
+ */
+void DeadFunctionEliminator::visitCallExpr(CallExprAST *call_expr){
+	markReachable(call_expr->getCalleeSymbol());
+	for(int i = 0; i < call_expr->getArgNum(); i++)
+		Pending.push_back(call_expr->getArgs(i));
+}
+
+/**
+ * returnで返す式を辿る
+ * @param JumpStmtAST
+ */
+void DeadFunctionEliminator::visitJumpStmt(JumpStmtAST *jump_stmt){
+	Pending.push_back(jump_stmt->getExpr());
+}
@@ -0,0 +1,336 @@
+#include "funceval.hpp"
+#include "astopt.hpp"
+
+/**
+ * 1回のコンパイル時の関数呼び出しで実行できるノード数（呼び出し先を含む）
+ */
+static const long MaxEvalFuel = 10000;
+
+/**
+ * TranslationUnitASTの関数定義を登録する
+ * @param TranslationUnitAST
+ */
+void FunctionInterpreter::setTranslationUnit(TranslationUnitAST &tunit){
+	Functions.clear();
+	Results.clear();
+	for(int i = 0; FunctionAST *func = tunit.getFunction(i); i++)
+		Functions.insert(func->getPrototype()->getSymbol(), func);
+}
+
+/**
+ * 関数を定数の引数で呼び出した結果を求める
+ * 結果を求められなかった場合も関数名と引数を覚えておき、同じ呼び出しは再び実行しない
+ * @param 関数名のシンボル番号, 引数, 結果の格納先
+ * @return 求められた場合:true 求められない場合:false
+ */
+bool FunctionInterpreter::call(int callee, const std::vector<int> &args, int &result){
+	Fuel = MaxEvalFuel;
+	Depth = 0;
+	Failed = false;
+	Returned = false;
+	if(callFunction(callee, args, result))
+		return true;
+
+	std::vector<int> key(1, callee);
+	key.insert(key.end(), args.begin(), args.end());
+	Results.insert(std::make_pair(key, std::make_pair(false, 0)));
+	return false;
+}
+
+/**
+ * 関数を実行する
+ * 引数を変数表の新しいスコープに登録し、returnするまで文を順に実行する
+ * @param 関数名のシンボル番号, 引数, 結果の格納先
+ * @return 成功時:true 失敗時:false
+ */
+bool FunctionInterpreter::callFunction(int callee, const std::vector<int> &args, int &result){
+	std::vector<int> key(1, callee);
+	key.insert(key.end(), args.begin(), args.end());
+	std::map<std::vector<int>, std::pair<bool, int> >::iterator found = Results.find(key);
+	if(found != Results.end()){
+		result = found->second.second;
+		return found->second.first;
+	}
+
+	// 定義の無い関数（printnumなど）は副作用を持つものとする
+	FunctionAST **func = Functions.lookup(callee);
+	if(!func || (*func)->getPrototype()->getParamNum() != args.size() || Depth >= MaxExpressionDepth)
+		return false;
+	CallNum++;
+
+	FunctionStmtAST *body = (*func)->getBody();
+	Variables.pushScope();
+	Depth++;
+	int param_index = 0;
+	for(int i = 0; VariableDeclAST *vdecl = body->getVariableDecl(i); i++){
+		VariableValue value = {false, 0};
+		if(vdecl->getType() == VariableDeclAST::param){
+			value.Known = true;
+			value.Value = args[param_index++];
+		}
+		Variables.insert(vdecl->getSymbol(), value);
+	}
+
+	int value = 0;
+	Returned = false;
+	for(int i = 0; BaseAST *stmt = body->getStatement(i); i++){
+		if(stmt->getValueID() == NullExprID)
+			continue;
+		int v = evaluateExpression(stmt);
+		if(Failed || Returned){
+			value = v;
+			break;
+		}
+	}
+	bool succeeded = !Failed && Returned;
+	Returned = false;
+	Depth--;
+	Variables.popScope();
+
+	if(!succeeded)
+		return false;
+	Results.insert(std::make_pair(key, std::make_pair(true, value)));
+	result = value;
+	return true;
+}
+
+/**
+ * 式を実行する
+ * 実行できるノード数・深さの上限を超えた場合は失敗とする
+ * @param 式
+ * @return 式の値
+ */
+int FunctionInterpreter::evaluateExpression(BaseAST *expr){
+	if(Failed)
+		return 0;
+	if(--Fuel < 0 || Depth >= MaxExpressionDepth){
+		Failed = true;
+		return 0;
+	}
+	Depth++;
+	int value = visit(expr);
+	Depth--;
+	return value;
+}
+
+/**
+ * 二項演算を実行する
+ * 代入式の値は右辺の値
+ * @param BinaryExprAST
+ * @return 式の値
+ */
+int FunctionInterpreter::visitBinaryExpr(BinaryExprAST *bin_expr){
+	if(bin_expr->getOp() == BINOP_ASSIGN){
+		int rhs = evaluateExpression(bin_expr->getRHS());
+		VariableValue *var = Variables.lookup(llvm::cast<VariableAST>(bin_expr->getLHS())->getSymbol());
+		if(!var){
+			Failed = true;
+			return 0;
+		}
+		var->Known = true;
+		var->Value = rhs;
+		return rhs;
+	}
+
+	int lhs = evaluateExpression(bin_expr->getLHS());
+	int rhs = evaluateExpression(bin_expr->getRHS());
+	int result = 0;
+	if(!Failed && !ConstantFolder::evaluate(bin_expr->getOp(), lhs, rhs, result))
+		Failed = true;
+	return result;
+}
+
+/**
+ * 関数呼び出しを実行する
+ * @param CallExprAST
+ * @return 呼び出した関数の戻り値
+ */
+int FunctionInterpreter::visitCallExpr(CallExprAST *call_expr){
+	std::vector<int> args;
+	for(int i = 0; i < call_expr->getArgNum(); i++)
+		args.push_back(evaluateExpression(call_expr->getArgs(i)));
+	int result = 0;
+	if(!Failed && !callFunction(call_expr->getCalleeSymbol(), args, result))
+		Failed = true;
+	return result;
+}
+
+/**
+ * return文を実行する
+ * @param JumpStmtAST
+ * @return 戻り値
+ */
+int FunctionInterpreter::visitJumpStmt(JumpStmtAST *jump_stmt){
+	int value = evaluateExpression(jump_stmt->getExpr());
+	Returned = true;
+	return value;
+}
+
+/**
+ * 変数参照を実行する（代入前の変数の値は不定のため失敗とする）
+ * @param VariableAST
+ * @return 変数の値
+ */
+int FunctionInterpreter::visitVariable(VariableAST *var){
+	VariableValue *value = Variables.lookup(var->getSymbol());
+	if(!value || !value->Known){
+		Failed = true;
+		return 0;
+	}
+	return value->Value;
+}
+
+/**
+ * 数値を実行する
+ * @param NumberAST
+ * @return 数値
+ */
+int FunctionInterpreter::visitNumber(NumberAST *num){
+	return num->getNumberValue();
+}
+
+/**
+ * 実行できないAST
+ * @param BaseAST
+ * @return 0
+ */
+int FunctionInterpreter::visitBase(BaseAST *ast){
+	Failed = true;
+	return 0;
+}
+
+/**
+ * TranslationUnitASTの全関数の式を書き換える
+ * 各関数の引数・変数は値の分からない状態から始め、文を先頭から順に書き換える
+ * （return文より後の文は実行されないため書き換えない）
+ * @param 書き換えるTranslationUnitAST
+ */
+void ConstantPropagator::propagate(TranslationUnitAST &tunit){
+	Nodes = &tunit.getArena();
+	Interpreter.setTranslationUnit(tunit);
+	for(int i = 0; FunctionAST *func = tunit.getFunction(i); i++){
+		CurBody = func->getBody();
+		Variables.clear();
+		for(int j = 0; VariableDeclAST *vdecl = CurBody->getVariableDecl(j); j++){
+			VariableValue value = {false, 0};
+			Variables.insert(vdecl->getSymbol(), value);
+		}
+		for(int j = 0; BaseAST *stmt = CurBody->getStatement(j); j++){
+			Depth = 0;
+			CurBody->setStatement(j, rewriteExpression(stmt));
+			if(stmt->getValueID() == JumpStmtID)
+				break;
+		}
+	}
+}
+
+/**
+ * 式を書き換える
+ * 深さがMaxExpressionDepthを超えた部分木はそのまま残し、その中の代入で
+ * 変わりうるため全変数の値を分からない状態に戻す
+ * @param 式
+ * @return 書き換えた式
+ */
+BaseAST *ConstantPropagator::rewriteExpression(BaseAST *expr){
+	if(Depth >= MaxExpressionDepth){
+		for(int i = 0; VariableDeclAST *vdecl = CurBody->getVariableDecl(i); i++)
+			setValue(vdecl->getSymbol(), false, 0);
+		return expr;
+	}
+	Depth++;
+	BaseAST *rewritten = visit(expr);
+	Depth--;
+	return rewritten;
+}
+
+/**
+ * 変数の現時点の値を設定する
+ * @param 変数名のシンボル番号, 値が分かっているか, 値
+ */
+void ConstantPropagator::setValue(int symbol, bool known, int value){
+	VariableValue *var = Variables.lookup(symbol);
+	if(var){
+		var->Known = known;
+		var->Value = value;
+	}
+}
+
+/**
+ * 二項演算を書き換える
+ * 代入は右辺を書き換え、右辺が定数なら変数の値として覚える
+ * @param BinaryExprAST
+ * @return 書き換えた式
+ */
+BaseAST *ConstantPropagator::visitBinaryExpr(BinaryExprAST *bin_expr){
+	if(bin_expr->getOp() == BINOP_ASSIGN){
+		bin_expr->setRHS(rewriteExpression(bin_expr->getRHS()));
+		NumberAST *rhs_num = llvm::dyn_cast<NumberAST>(bin_expr->getRHS());
+		setValue(llvm::cast<VariableAST>(bin_expr->getLHS())->getSymbol(),
+				rhs_num != NULL, rhs_num ? rhs_num->getNumberValue() : 0);
+		return bin_expr;
+	}
+
+	bin_expr->setLHS(rewriteExpression(bin_expr->getLHS()));
+	bin_expr->setRHS(rewriteExpression(bin_expr->getRHS()));
+	NumberAST *lhs_num = llvm::dyn_cast<NumberAST>(bin_expr->getLHS());
+	NumberAST *rhs_num = llvm::dyn_cast<NumberAST>(bin_expr->getRHS());
+	int result;
+	if(!lhs_num || !rhs_num ||
+			!ConstantFolder::evaluate(bin_expr->getOp(), lhs_num->getNumberValue(), rhs_num->getNumberValue(), result))
+		return bin_expr;
+	FoldedNum++;
+	return new (*Nodes) NumberAST(result);
+}
+
+/**
+ * 関数呼び出しを書き換える
+ * 引数がすべて定数になれば、コンパイル時に実行して結果に置き換える
+ * @param CallExprAST
+ * @return 書き換えた式
+ */
+BaseAST *ConstantPropagator::visitCallExpr(CallExprAST *call_expr){
+	std::vector<int> args;
+	for(int i = 0; i < call_expr->getArgNum(); i++){
+		call_expr->setArgs(i, rewriteExpression(call_expr->getArgs(i)));
+		if(NumberAST *arg_num = llvm::dyn_cast<NumberAST>(call_expr->getArgs(i)))
+			args.push_back(arg_num->getNumberValue());
+	}
+	int result;
+	if(args.size() != call_expr->getArgNum() ||
+			!Interpreter.call(call_expr->getCalleeSymbol(), args, result))
+		return call_expr;
+	EvaluatedNum++;
+	return new (*Nodes) NumberAST(result);
+}
+
+/**
+ * returnで返す式を書き換える
+ * @param JumpStmtAST
+ * @return 元の文
+ */
+BaseAST *ConstantPropagator::visitJumpStmt(JumpStmtAST *jump_stmt){
+	jump_stmt->setExpr(rewriteExpression(jump_stmt->getExpr()));
+	return jump_stmt;
+}
+
+/**
+ * 変数参照を書き換える（値が分かっていれば数値にする）
+ * @param VariableAST
+ * @return 書き換えた式
+ */
+BaseAST *ConstantPropagator::visitVariable(VariableAST *var){
+	VariableValue *value = Variables.lookup(var->getSymbol());
+	if(!value || !value->Known)
+		return var;
+	PropagatedNum++;
+	return new (*Nodes) NumberAST(value->Value);
+}
+
+/**
+ * 数値など書き換えないAST
+ * @param BaseAST
+ * @return 元のAST
+ */
+BaseAST *ConstantPropagator::visitBase(BaseAST *ast){
+	return ast;
+}
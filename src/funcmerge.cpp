@@ -0,0 +1,250 @@
+#include "funcmerge.hpp"
+#include "astcache.hpp"
+
+/**
+ * 書き出す構造の各要素の種類（後に続く値）
+ */
+enum EncodeTag{
+	ENC_FUNCTION,  // 関数定義（変数の数, 文の数）
+	ENC_DECL,      // 変数宣言（宣言種別）
+	ENC_NUMBER,    // 数値（値）
+	ENC_LOCAL,     // 引数・変数の参照（宣言順の番号）
+	ENC_GLOBAL,    // 宣言の無い変数の参照（名前のハッシュ値）
+	ENC_ASSIGN,    // 代入（代入先、右辺の順に続く）
+	ENC_BINARY,    // 二項演算（演算子）
+	ENC_CALL,      // 関数呼び出し（関数名のハッシュ値, 引数の数）
+	ENC_SELF_CALL, // 自分自身の呼び出し（引数の数）
+	ENC_RETURN,    // return文
+	ENC_NULL       // 空の文
+};
+
+/**
+ * 関数定義の構造を書き出す
+ * 変数宣言を宣言順に番号付けした後、各文を先行順に書き出す
+ * （子の数は各ノードの値から決まるため、区切りを入れなくても元の木が一意に定まる）
+ * @param 関数定義, 構造の書き出し先, 名前で区別するシンボル番号の書き出し先
+ */
+void FunctionEncoder::encode(FunctionAST *func, std::vector<unsigned int> &code, std::vector<int> &symbols){
+	Code = &code;
+	Symbols = &symbols;
+	code.clear();
+	symbols.clear();
+	Locals.clear();
+	Self = func->getPrototype()->getSymbol();
+	DeclNum = 0;
+	InstNum = 0;
+
+	FunctionStmtAST *body = func->getBody();
+	int var_num = 0;
+	while(body->getVariableDecl(var_num))
+		var_num++;
+	int stmt_num = 0;
+	while(body->getStatement(stmt_num))
+		stmt_num++;
+	code.push_back(ENC_FUNCTION);
+	code.push_back(var_num);
+	code.push_back(stmt_num);
+
+	for(int i = 0; i < var_num; i++)
+		visit(body->getVariableDecl(i));
+
+	for(int i = 0; i < stmt_num; i++){
+		Pending.push_back(body->getStatement(i));
+		while(!Pending.empty()){
+			BaseAST *node = Pending.back();
+			Pending.pop_back();
+			visit(node);
+		}
+	}
+}
+
+/**
+ * 書き出した構造のハッシュ値を求める
+ * @param 書き出した構造
+ * @return ハッシュ値
+ */
+unsigned long long FunctionEncoder::computeHash(const std::vector<unsigned int> &code){
+	return ASTCache::computeHash((const char*)code.data(), code.size() * sizeof(unsigned int));
+}
+
+/**
+ * 変数宣言を書き出し、宣言順の番号を変数表に登録する
+ * 引数はallocaとstore、ローカル変数はallocaを生成する
+ * @param VariableDeclAST
+ */
+void FunctionEncoder::visitVariableDecl(VariableDeclAST *vdecl){
+	bool is_param = vdecl->getType() == VariableDeclAST::param;
+	Code->push_back(ENC_DECL);
+	Code->push_back(is_param);
+	Locals.insert(vdecl->getSymbol(), DeclNum++);
+	InstNum += is_param ? 2 : 1;
+}
+
+/**
+ * 二項演算を書き出す
+ * 代入は代入先を書き出した後に右辺のみ辿る（代入先はloadしない）
+ * @param BinaryExprAST
+ */
+void FunctionEncoder::visitBinaryExpr(BinaryExprAST *bin_expr){
+	InstNum++;
+	if(bin_expr->getOp() == BINOP_ASSIGN){
+		Code->push_back(ENC_ASSIGN);
+		encodeVariable(llvm::cast<VariableAST>(bin_expr->getLHS())->getSymbol());
+		Pending.push_back(bin_expr->getRHS());
+		return;
+	}
+	Code->push_back(ENC_BINARY);
+	Code->push_back(bin_expr->getOp());
+	Pending.push_back(bin_expr->getRHS());
+	Pending.push_back(bin_expr->getLHS());
+}
+
+/**
+ * 関数呼び出しを書き出す
+ * @param CallExprAST
+ */
+void FunctionEncoder::visitCallExpr(CallExprAST *call_expr){
+	int callee = call_expr->getCalleeSymbol();
+	if(callee == Self){
+		Code->push_back(ENC_SELF_CALL);
+	}else{
+		Code->push_back(ENC_CALL);
+		Code->push_back(getNameHash(callee));
+		Symbols->push_back(callee);
+	}
+	Code->push_back(call_expr->getArgNum());
+	for(int i = call_expr->getArgNum() - 1; i >= 0; i--)
+		Pending.push_back(call_expr->getArgs(i));
+	InstNum++;
+}
+
+/**
+ * return文を書き出す
+ * @param JumpStmtAST
+ */
+void FunctionEncoder::visitJumpStmt(JumpStmtAST *jump_stmt){
+	Code->push_back(ENC_RETURN);
+	Pending.push_back(jump_stmt->getExpr());
+	InstNum++;
+}
+
+/**
+ * 変数参照を書き出す
+ * @param VariableAST
+ */
+void FunctionEncoder::visitVariable(VariableAST *var){
+	encodeVariable(var->getSymbol());
+	InstNum++;
+}
+
+/**
+ * 数値を書き出す（命令は生成されない）
+ * @param NumberAST
+ */
+void FunctionEncoder::visitNumber(NumberAST *num){
+	Code->push_back(ENC_NUMBER);
+	Code->push_back(num->getNumberValue());
+}
+
+/**
+ * 空の文を書き出す
+ * @param BaseAST
+ */
+void FunctionEncoder::visitBase(BaseAST *ast){
+	Code->push_back(ENC_NULL);
+}
+
+/**
+ * 変数を宣言順の番号で書き出す（宣言が無ければ名前で書き出す）
+ * @param 変数名のシンボル番号
+ */
+void FunctionEncoder::encodeVariable(int symbol){
+	int *index = Locals.lookup(symbol);
+	if(index){
+		Code->push_back(ENC_LOCAL);
+		Code->push_back(*index);
+	}else{
+		Code->push_back(ENC_GLOBAL);
+		Code->push_back(getNameHash(symbol));
+		Symbols->push_back(symbol);
+	}
+}
+
+/**
+ * 名前の文字列のハッシュ値を求める（シンボル番号ごとに1度だけ計算する）
+ * @param シンボル番号
+ * @return ハッシュ値（32bitに折り畳んだもの、0にはしない）
+ */
+unsigned int FunctionEncoder::getNameHash(int symbol){
+	if(symbol >= NameHashes.size())
+		NameHashes.resize(symbol + 1, 0);
+	if(NameHashes[symbol] == 0){
+		const std::string &name = StringInterner::getGlobal().getString(symbol);
+		unsigned long long hash = ASTCache::computeHash(name.data(), name.size());
+		NameHashes[symbol] = (unsigned int)(hash ^ (hash >> 32)) | 1;
+	}
+	return NameHashes[symbol];
+}
+
+/**
+ * TranslationUnitASTの構造の同じ関数定義を統合する
+ * 関数定義を先頭から順に書き出し、ハッシュ値が一致する統合先と構造を比べて、
+ * 一致すれば統合先を呼ぶthunkに置き換える（統合先は常に前にあるため宣言済みになる）
+ * @param 統合するTranslationUnitAST
+ */
+void FunctionMerger::merge(TranslationUnitAST &tunit){
+	Hashes.clear();
+	Groups.clear();
+	std::vector<unsigned int> code, target_code;
+	std::vector<int> symbols, target_symbols;
+	for(int i = 0; FunctionAST *func = tunit.getFunction(i); i++){
+		Encoder.encode(func, code, symbols);
+		long inst_num = Encoder.getInstNum();
+		TotalInstNum += inst_num;
+		unsigned long long hash = FunctionEncoder::computeHash(code);
+		Hashes.push_back(hash);
+
+		// ハッシュ値の衝突に備えて構造を比べる
+		std::vector<int> &group = Groups[hash];
+		FunctionAST *target = NULL;
+		for(int j = 0; j < group.size() && !target; j++){
+			Encoder.encode(tunit.getFunction(group[j]), target_code, target_symbols);
+			if(target_code == code && target_symbols == symbols)
+				target = tunit.getFunction(group[j]);
+		}
+		if(!target){
+			group.push_back(i);
+			continue;
+		}
+
+		// thunkは引数ごとにalloca, store, loadと、call, retを生成する
+		PrototypeAST *proto = func->getPrototype();
+		long thunk_inst_num = 3 * proto->getParamNum() + 2;
+		if(inst_num <= thunk_inst_num || target->getPrototype()->getSymbol() == proto->getSymbol())
+			continue;
+		tunit.replaceFunction(i, createThunk(tunit.getArena(), func, target));
+		MergedNum++;
+		SavedInstNum += inst_num - thunk_inst_num;
+	}
+}
+
+/**
+ * 統合先の関数を呼んで結果を返すだけの関数定義を作る
+ * 元の関数定義の本体の領域はArenaの破棄まで残る
+ * @param 確保先のArena, 置き換える関数定義, 統合先の関数定義
+ * @return thunkの関数定義
+ */
+FunctionAST *FunctionMerger::createThunk(Arena &arena, FunctionAST *func, FunctionAST *target){
+	PrototypeAST *proto = func->getPrototype();
+	FunctionStmtAST *body = new (arena) FunctionStmtAST(arena);
+	std::vector<BaseAST*> args;
+	for(int i = 0; i < proto->getParamNum(); i++){
+		VariableDeclAST *vdecl = new (arena) VariableDeclAST(proto->getParamSymbol(i));
+		vdecl->setDeclType(VariableDeclAST::param);
+		body->addVariableDeclaration(vdecl);
+		args.push_back(new (arena) VariableAST(proto->getParamSymbol(i)));
+	}
+	CallExprAST *call_expr = new (arena) CallExprAST(arena, target->getPrototype()->getSymbol(), args);
+	body->addStatement(new (arena) JumpStmtAST(call_expr));
+	return new (arena) FunctionAST(proto, body);
+}
@@ -1,138 +1,388 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "charscan.hpp"
 #include "lexer.hpp"
+#include "threadpool.hpp"
 
 /**
- * トークンの切り出し関数
- * @ param 字句解析対象ファイル名
- * @ return 切り出したトークンを格納したTokenStream
+ * ソースファイルを開いてSourceBufferを生成する
+ * 通常はmmapでマップし、できない場合（空ファイル、パイプ等）はread()で読み込む
+ * @param ファイル名
+ * @return 成功時:SourceBuffer 失敗時:NULL
  */
-TokenStream *LexicalAnalysis(std::string input_filename){
-	TokenStream *tokens = new TokenStream();
-	std::ifstream ifs;
-	std::string cur_line;
-	std::string token_str;
-	int line_num = 0;
-	bool iscomment = false;
-
-	ifs.open(input_filename.c_str(), std::ios::in);
-	if (!ifs){
-		fprintf(stderr, "file is not found\n");
+SourceBuffer *SourceBuffer::open(const std::string &file_name){
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if(fd < 0)
 		return NULL;
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+		void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(addr != MAP_FAILED){
+			madvise(addr, st.st_size, MADV_SEQUENTIAL);
+			close(fd);
+			return new SourceBuffer((const char*)addr, st.st_size, true);
+		}
 	}
-	while (ifs && getline(ifs,cur_line)){
-		char next_char;
-		std::string line;
-		Token *next_token;
-		int index = 0;
-		int length = cur_line.length();
-
-		while(index < length){
-			next_char = cur_line.at(index++);
-
-			// コメント読み飛ばし
-			if(iscomment){
-				if ((length-index) < 2 || 
-						(cur_line.at(index) != '*') || 
-						(cur_line.at(index++) != '/')){
-					continue;
-				}else{
-					iscomment = false;
-				}
-			}
 
-			// EOF
-			if (next_char == EOF){
-				token_str = EOF;
-				next_token = new Token(token_str, TOK_EOF, line_num);
-			}else if (isspace(next_char)){
-				continue;
-			}else if (isalpha(next_char)){
-				token_str += next_char;
-				next_char = cur_line.at(index++);
-				while (isalnum(next_char)){
-					token_str += next_char;
-					next_char = cur_line.at(index++);
-					if (index == length){
-						break;
-					}
-				}
-				index--;
-
-				if (token_str == "int"){
-					next_token = new Token(token_str,TOK_INT,line_num);
-				}else if (token_str == "return"){
-					next_token = new Token(token_str,TOK_RETURN,line_num);
-				}else{
-					next_token = new Token(token_str,TOK_IDENTIFIER,line_num);
-				}
-			// 数字
-			}else if (isdigit(next_char)){
-				if (next_char == '0'){
-					token_str += next_char;
-					next_token = new Token(token_str,TOK_DIGIT,line_num);
-				}else{
-					token_str += next_char;
-					next_char = cur_line.at(index++);
-					while (isdigit(next_char)){
-						token_str += next_char;
-						next_char = cur_line.at(index++);
-					}
-					next_token = new Token(token_str,TOK_DIGIT,line_num);
-					index--;
+	// mmapできない場合はヒープに読み込む
+	std::vector<char> data;
+	char chunk[65536];
+	ssize_t len;
+	while((len = read(fd, chunk, sizeof(chunk))) > 0){
+		data.insert(data.end(), chunk, chunk + len);
+	}
+	close(fd);
+	if(len < 0)
+		return NULL;
+
+	char *buffer = new char[data.size() + 1];
+	if(!data.empty())
+		memcpy(buffer, &data[0], data.size());
+	return new SourceBuffer(buffer, data.size(), false);
+}
+
+/**
+ * メモリ上の文字列をコピーしてSourceBufferを生成する
+ * @param 文字列, バイト数
+ * @return 生成したSourceBuffer
+ */
+SourceBuffer *SourceBuffer::copy(const char *data, size_t size){
+	char *buffer = new char[size + 1];
+	memcpy(buffer, data, size);
+	return new SourceBuffer(buffer, size, false);
+}
+
+/**
+ * デストラクタ
+ */
+SourceBuffer::~SourceBuffer(){
+	if(IsMapped){
+		munmap((void*)Buffer, Size);
+	}else{
+		delete[] Buffer;
+	}
+}
+
+/**
+ * 識別子がキーワードであればその種別を返す
+ * 長さと先頭文字で候補を1つに絞ってから比較する
+ * @param 識別子の先頭, 文字数
+ * @return キーワードの種別 キーワードでない場合:TOK_IDENTIFIER
+ */
+static TokenType getKeywordType(const char *str, int length){
+	switch(length){
+		case 3:
+			if(str[0] == 'i' && memcmp(str, "int", 3) == 0)
+				return TOK_INT;
+			break;
+		case 6:
+			if(str[0] == 'r' && memcmp(str, "return", 6) == 0)
+				return TOK_RETURN;
+			break;
+	}
+	return TOK_IDENTIFIER;
+}
+
+/**
+ * 1文字の記号の種別を返す
+ * @param 文字
+ * @return 記号の種別 記号でない場合:TOK_EOF
+ */
+static TokenType getSymbolType(char c){
+	switch(c){
+		case '(': return TOK_LPAREN;
+		case ')': return TOK_RPAREN;
+		case '{': return TOK_LBRACE;
+		case '}': return TOK_RBRACE;
+		case ';': return TOK_SEMICOLON;
+		case ',': return TOK_COMMA;
+		case '=': return TOK_ASSIGN;
+		case '+': return TOK_PLUS;
+		case '-': return TOK_MINUS;
+		case '*': return TOK_STAR;
+		case '/': return TOK_SLASH;
+		default:  return TOK_EOF;
+	}
+}
+
+/**
+ * トークンの切り出し関数
+ * バッファの現在位置から次のトークンを1つ切り出す
+ * 行数は改行を数えて求める
+ * @param 切り出したトークンの種別, 開始位置, 文字数, 数値, 行数
+ * @return 成功時:true 解析不可能な文字があった場合:false
+ */
+bool Lexer::lexToken(TokenType &type, int &offset, int &length, int &number, int &line){
+	const char *begin = Source->getBegin();
+	const char *end = End;
+	const char *cur = Cur;
+
+	// ブロックコメントの途中から始まる範囲
+	if (InComment){
+		cur = scanCommentEnd(cur, end, &LineNum);
+		InComment = (cur == end);
+		cur = InComment ? end : cur + 2;
+	}
+
+	while(cur < end){
+		const char *token_begin = cur;
+		char next_char = *cur++;
+		number = 0x7fffffff;
+
+		// 空白（改行を含む）
+		if (isSpaceChar(next_char)){
+			if (next_char == '\n')
+				LineNum++;
+			cur = scanSpace(cur, end, &LineNum);
+			continue;
+		// 識別子
+		}else if (isAlphaChar(next_char)){
+			cur = scanAlnum(cur, end);
+			type = getKeywordType(token_begin, cur - token_begin);
+			if (type == TOK_IDENTIFIER)
+				number = Symbols->intern(token_begin, cur - token_begin);
+		// 数字
+		}else if (isDigitChar(next_char)){
+			unsigned int value = next_char - '0';
+			if (next_char != '0'){
+				cur = scanDigit(cur, end);
+				for (const char *digit = token_begin + 1; digit < cur; digit++){
+					value = value * 10 + (*digit - '0');
 				}
-			// コメントまたは除算演算子
-			}else if (next_char == '/'){
-				token_str += next_char;
-				next_char = cur_line.at(index++);
-
-				//コメントの場合
-				if(next_char == '/'){
-					break;
-				}else if (next_char == '*'){
-					iscomment = true;
-					continue;
-				}else{
-					index--;
-					next_token = new Token(token_str,TOK_SYMBOL,line_num);
+			}
+			type = TOK_DIGIT;
+			number = (int)value;
+		// コメントまたは除算演算子
+		}else if (next_char == '/'){
+			//コメントの場合
+			if (cur < end && *cur == '/'){
+				cur = (const char*)memchr(cur, '\n', end - cur);
+				if (!cur){
+					cur = end;
+					InLineComment = true;
 				}
-			//それ以外 (記号)
+				continue;
+			}else if (cur < end && *cur == '*'){
+				cur = scanCommentEnd(cur + 1, end, &LineNum);
+				InComment = (cur == end);
+				cur = InComment ? end : cur + 2;
+				continue;
 			}else{
-				if (next_char == '*' ||
-				    next_char == '+' ||
-				    next_char == '-' ||
-				    next_char == '=' ||
-				    next_char == ';' ||
-				    next_char == ',' ||
-				    next_char == '(' ||
-				    next_char == ')' ||
-				    next_char == '{' ||
-				    next_char == '}'){
-					token_str += next_char;
-					next_token = new Token(token_str,TOK_SYMBOL,line_num);
-				// 解析不可能
-				}else{
-					fprintf(stderr,"unclear token : %c\n", next_char);
-					SAFE_DELETE(tokens);
-					return NULL;
-				}
+				type = TOK_SLASH;
+			}
+		//それ以外 (記号)
+		}else{
+			type = getSymbolType(next_char);
+			// 解析不可能
+			if (type == TOK_EOF){
+				ErrorChar = next_char;
+				Cur = cur;
+				offset = token_begin - begin;
+				length = 1;
+				line = LineNum;
+				return false;
 			}
+		}
+
+		Cur = cur;
+		offset = token_begin - begin;
+		length = cur - token_begin;
+		line = LineNum;
+		return true;
+	}
+
+	// EOF
+	Cur = end;
+	type = TOK_EOF;
+	offset = end - begin;
+	length = 0;
+	number = 0x7fffffff;
+	line = LineNum;
+	return true;
+}
+
+/**
+ * Lexerの範囲をEOFまで切り出してTokenStreamに追加する
+ * @param Lexer, 格納先のTokenStream
+ * @return 成功時:true 失敗時:false
+ */
+bool LexicalAnalysis(Lexer *lex, TokenStream *tokens){
+	TokenType type;
+	int offset, length, number, line;
+	do{
+		if (!lex->lexToken(type, offset, length, number, line)){
+			lex->printError();
+			return false;
+		}
+		tokens->pushToken(type, offset, length, number, line);
+	}while(type != TOK_EOF);
+	return true;
+}
+
+/**
+ * 並列字句解析の1分割分の結果
+ */
+struct LexChunk{
+	const char *Begin;
+	const char *End;
+	TokenStream Tokens;
+	int Lines;       // 分割内の改行数
+	bool InComment;  // ブロックコメントの途中で分割が終わったか
+	bool Error;      // 解析不可能な文字があったか
+	Lexer *Lex;
+	StringInterner Symbols; // 分割内の識別子（連結時に共有の番号に置き換える）
+
+	LexChunk() : Lines(0), InComment(false), Error(false), Lex(NULL){}
+	~LexChunk(){SAFE_DELETE(Lex);}
+};
+
+/**
+ * 1分割分の字句解析（EOFは追加しない）
+ * @param ソース, 分割, 分割の先頭がブロックコメントの途中か
+ */
+static void lexChunk(SourceBuffer *source, LexChunk *chunk, bool in_comment){
+	SAFE_DELETE(chunk->Lex);
+	Lexer *lex = chunk->Lex = new Lexer(source, chunk->Begin, chunk->End, in_comment);
+	lex->setInterner(&chunk->Symbols);
+	TokenType type;
+	int offset, length, number, line;
+
+	chunk->Tokens.clear();
+	chunk->Symbols = StringInterner();
+	chunk->Error = false;
+	while (true){
+		if (!lex->lexToken(type, offset, length, number, line)){
+			chunk->Error = true;
+			break;
+		}
+		if (type == TOK_EOF)
+			break;
+		chunk->Tokens.pushToken(type, offset, length, number, line);
+	}
+	chunk->Lines = lex->getLineNum();
+	chunk->InComment = lex->isInComment();
+}
+
+/**
+ * 並列字句解析関数
+ * ソースを行の先頭で分割してスレッドプールで字句解析し、結果を順に連結する
+ * 各分割はブロックコメントの外から始まると仮定して解析し、
+ * 直前の分割がコメントの途中で終わっていた場合のみ解析し直すため、
+ * 結果は逐次の字句解析と同一になる
+ * @param ソース, 結果を格納するTokenStream, スレッド数（0の場合はハードウェアのスレッド数）
+ * @return 成功時:true 失敗時:false
+ */
+bool ParallelLexicalAnalysis(SourceBuffer *source, TokenStream *tokens, int num_threads){
+	const size_t min_chunk_size = 256 * 1024;
+	if (num_threads <= 0)
+		num_threads = ThreadPool::getHardwareThreads();
+	size_t size = source->getSize();
+	int num_chunks = std::min<size_t>(num_threads * 4, size / min_chunk_size);
+
+	// 分割しても速くならない場合は逐次に切り出す
+	if (num_chunks <= 1 || num_threads == 1){
+		Lexer lex(source);
+		return LexicalAnalysis(&lex, tokens);
+	}
+
+	// 行の先頭で分割
+	std::vector<LexChunk> chunks(num_chunks);
+	const char *cur = source->getBegin();
+	const char *end = source->getEnd();
+	for (int i = 0; i < num_chunks; i++){
+		const char *split = source->getBegin() + size * (i + 1) / num_chunks;
+		if (split <= cur){
+			split = cur;
+		}else if (split < end){
+			const char *newline = (const char*)memchr(split - 1, '\n', end - split + 1);
+			split = newline ? newline + 1 : end;
+		}
+		chunks[i].Begin = cur;
+		chunks[i].End = split;
+		cur = split;
+	}
 
-			// Tokensに追加
-			tokens->pushToken(next_token);
-			token_str.clear();
+	// 各分割をコメントの外から始まると仮定して並列に解析
+	ThreadPool pool(num_threads);
+	for (int i = 0; i < num_chunks; i++)
+		pool.addTask(std::bind(lexChunk, source, &chunks[i], false));
+	pool.wait();
+
+	// コメントの状態を引き継いで連結
+	StringInterner &symbols = StringInterner::getGlobal();
+	std::vector<int> symbol_map;
+	bool in_comment = false;
+	int line_offset = 0;
+	for (int i = 0; i < num_chunks; i++){
+		if (in_comment)
+			lexChunk(source, &chunks[i], true);
+		if (chunks[i].Error){
+			chunks[i].Lex->printError();
+			return false;
 		}
 
-		token_str.clear();
-		line_num++;
+		// 分割内のシンボル番号を共有の番号に対応付ける
+		StringInterner &chunk_symbols = chunks[i].Symbols;
+		symbol_map.resize(chunk_symbols.size());
+		for (int j = 0; j < chunk_symbols.size(); j++)
+			symbol_map[j] = symbols.intern(chunk_symbols.getString(j));
+		tokens->appendTokens(chunks[i].Tokens, line_offset, &symbol_map);
+		line_offset += chunks[i].Lines;
+		in_comment = chunks[i].InComment;
+	}
+
+	// EOF
+	tokens->pushToken(TOK_EOF, size, 0, 0x7fffffff, line_offset);
+	return true;
+}
+
+/**
+ * 字句解析関数
+ * @ param 字句解析対象ファイル名, 字句解析の方式
+ * @ return 切り出したトークンを格納したTokenStream
+ */
+TokenStream *LexicalAnalysis(std::string input_filename, LexMode mode){
+	SourceBuffer *source = SourceBuffer::open(input_filename);
+	if (!source){
+		fprintf(stderr, "file is not found\n");
+		return NULL;
 	}
+	return LexicalAnalysis(source, mode);
+}
+
+/**
+ * 字句解析関数
+ * LEX_BATCHではファイル全体のトークンを切り出して格納する
+ * LEX_STREAMではLexerを設定したTokenStreamを返し、構文解析の要求に応じて切り出す
+ * LEX_PARALLELではParallelLexicalAnalysisで切り出す
+ * @ param 字句解析対象のソース（所有権を移す）, 字句解析の方式
+ * @ return 切り出したトークンを格納したTokenStream
+ */
+TokenStream *LexicalAnalysis(SourceBuffer *source, LexMode mode){
+	TokenStream *tokens = new TokenStream();
+	tokens->setSource(source);
 
-	// EOFの確認
-	if (ifs.eof()){
-		tokens->pushToken(new Token(token_str,TOK_EOF,line_num));
+	if (mode == LEX_PARALLEL){
+		if (!ParallelLexicalAnalysis(source, tokens)){
+			SAFE_DELETE(tokens);
+			return NULL;
+		}
+		return tokens;
 	}
 
+	if (mode == LEX_STREAM){
+		tokens->setLexer(new Lexer(source));
+		return tokens;
+	}
 
-	// クローズ
-	ifs.close();
+	Lexer lex(source);
+	if (!LexicalAnalysis(&lex, tokens)){
+		SAFE_DELETE(tokens);
+		return NULL;
+	}
 	return tokens;
 }
 
@@ -140,10 +390,60 @@ TokenStream *LexicalAnalysis(std::string input_filename){
  *  * デストラクタ
  *   */
 TokenStream::~TokenStream(){
-	for(int i=0;i<Tokens.size();i++){
-		SAFE_DELETE(Tokens[i]);
+	SAFE_DELETE(Lex);
+	SAFE_DELETE(Source);
+}
+
+/**
+ *  * 逐次切り出し用のLexerを設定し、最初のトークンを切り出す
+ *   * @return 成功時:true 失敗時:false
+ *    */
+bool TokenStream::setLexer(Lexer *lex){
+	Lex = lex;
+	return fetchToken();
+}
+
+/**
+ *  * Lexerから次のトークンを1つ切り出して末尾に追加する
+ *   * 字句解析エラーの場合はエラーを記録してTOK_EOFを追加する
+ *   * @return 追加した場合:true 既にTOK_EOFまで切り出している場合:false
+ *    */
+bool TokenStream::fetchToken(){
+	if (!Lex || (!Types.empty() && Types.back() == TOK_EOF))
+		return false;
+
+	releaseTokens();
+
+	TokenType type;
+	int offset, length, number, line;
+	if (!Lex->lexToken(type, offset, length, number, line)){
+		Lex->printError();
+		LexError = true;
+		type = TOK_EOF;
+		length = 0;
 	}
-	Tokens.clear();
+	return pushToken(type, offset, length, number, line);
+}
+
+/**
+ *  * 最も古いチェックポイント（無ければ現在位置）より前のトークンを解放する
+ *   * 配列の詰め直しは解放できる数が保持数の半分を超えたときにまとめて行う
+ *    */
+void TokenStream::releaseTokens(){
+	int keep = CurIndex;
+	if (!Checkpoints.empty() && Checkpoints.front() < keep)
+		keep = Checkpoints.front();
+
+	int num = keep - Base;
+	if (num < 1024 || num * 2 < (int)Types.size())
+		return;
+
+	Types.erase(Types.begin(), Types.begin() + num);
+	Offsets.erase(Offsets.begin(), Offsets.begin() + num);
+	Lengths.erase(Lengths.begin(), Lengths.begin() + num);
+	Numbers.erase(Numbers.begin(), Numbers.begin() + num);
+	Lines.erase(Lines.begin(), Lines.begin() + num);
+	Base = keep;
 }
 
 /**
@@ -151,7 +451,63 @@ TokenStream::~TokenStream(){
  *   * @return CurIndex番目のToken
  *    */
 Token TokenStream::getToken(){
-	return *Tokens[CurIndex];
+	int i = CurIndex - Base;
+	return Token(getCurType(), getCurText(), Lengths[i], Numbers[i], Lines[i]);
+}
+
+/**
+ *  * 別のTokenStreamのトークンを末尾に追加する
+ *   * @param 追加するトークン, 行数に加える値, シンボル番号の対応（NULLの場合はそのまま）
+ *    */
+bool TokenStream::appendTokens(TokenStream &tokens, int line_offset, const std::vector<int> *symbol_map){
+	Types.insert(Types.end(), tokens.Types.begin(), tokens.Types.end());
+	Offsets.insert(Offsets.end(), tokens.Offsets.begin(), tokens.Offsets.end());
+	Lengths.insert(Lengths.end(), tokens.Lengths.begin(), tokens.Lengths.end());
+	int first = Numbers.size();
+	Numbers.insert(Numbers.end(), tokens.Numbers.begin(), tokens.Numbers.end());
+	if(symbol_map){
+		for(int i = first; i < Types.size(); i++){
+			if(Types[i] == TOK_IDENTIFIER)
+				Numbers[i] = (*symbol_map)[Numbers[i]];
+		}
+	}
+	Lines.insert(Lines.end(), tokens.Lines.begin(), tokens.Lines.end());
+	for(int i = first; i < Lines.size(); i++)
+		Lines[i] += line_offset;
+	return true;
+}
+
+/**
+ *  * 別のTokenStreamの[begin, end)番目のトークンを末尾に追加する
+ *   * @param 追加するトークン, 先頭のインデックス, 末尾の次のインデックス
+ *    */
+bool TokenStream::copyTokens(TokenStream &tokens, int begin, int end){
+	begin -= tokens.Base;
+	end -= tokens.Base;
+	if(begin < 0 || end > (int)tokens.Types.size() || begin > end)
+		return false;
+	Types.insert(Types.end(), tokens.Types.begin() + begin, tokens.Types.begin() + end);
+	Offsets.insert(Offsets.end(), tokens.Offsets.begin() + begin, tokens.Offsets.begin() + end);
+	Lengths.insert(Lengths.end(), tokens.Lengths.begin() + begin, tokens.Lengths.begin() + end);
+	Numbers.insert(Numbers.end(), tokens.Numbers.begin() + begin, tokens.Numbers.begin() + end);
+	Lines.insert(Lines.end(), tokens.Lines.begin() + begin, tokens.Lines.begin() + end);
+	return true;
+}
+
+/**
+ *  * 保持しているトークンをすべて破棄する
+ *    */
+bool TokenStream::clear(){
+	Types.clear();
+	Offsets.clear();
+	Lengths.clear();
+	Numbers.clear();
+	Lines.clear();
+	CurIndex = Base = MaxIndex = ReconsumedNum = 0;
+#ifdef DCC_PARSE_STATS
+	RewindNum = 0;
+#endif
+	return true;
 }
 
 /**
@@ -159,21 +515,39 @@ Token TokenStream::getToken(){
  *   * @return 成功時:true 失敗時:false
  *    */
 bool TokenStream::getNextToken(){
-	int size = Tokens.size();
-	if (--size<=CurIndex){
+	int size = Base + Types.size();
+	if (--size<=CurIndex && !fetchToken()){
 		return false;
 	}else{
+		if (CurIndex < MaxIndex)
+			ReconsumedNum++;
 		CurIndex++;
+		if (CurIndex > MaxIndex)
+			MaxIndex = CurIndex;
 	        return true;
 	}
 }
 
+/**
+ *  * 次のトークンの種類を取得する（インデックスは進めない）
+ *   * @return 次のトークンの種類 現在のトークンがTOK_EOFの場合:TOK_EOF
+ *    */
+TokenType TokenStream::peekType(){
+	// 切り出し時に先頭のトークンが解放されうるため、位置は切り出し後に求める
+	if (CurIndex + 1 - Base >= (int)Types.size() && !fetchToken())
+		return TOK_EOF;
+	return (TokenType)Types[CurIndex + 1 - Base];
+}
+
 /**
  *  * インデックスをtimes回回す
  *   */
 bool TokenStream::ungetToken(int times){
+#ifdef DCC_PARSE_STATS
+	RewindNum++;
+#endif
 	for(int i=0;i<times;i++){
-		if(CurIndex == 0)
+		if(CurIndex == Base)
 			return false;
 		else
 			CurIndex--;
@@ -185,12 +559,11 @@ bool TokenStream::ungetToken(int times){
  *  * 格納されたトークン一覧を表示する
  *   */
 bool TokenStream::printTokens(){
-	std::vector<Token*>::iterator titer = Tokens.begin();
-	while(titer != Tokens.end()){
-		fprintf(stdout,"%d:",(*titer)->getTokenType());
-		if((*titer)->getTokenType() != TOK_EOF)
-			fprintf(stdout,"%s\n",(*titer)->getTokenString().c_str());
-		++titer;
+	const char *begin = Source->getBegin();
+	for(int i = 0; i < Types.size(); i++){
+		fprintf(stdout,"%d:",Types[i]);
+		if(Types[i] != TOK_EOF)
+			fprintf(stdout,"%.*s\n",Lengths[i],begin + Offsets[i]);
 	}
 	return true;
 }
@@ -1,23 +1,57 @@
 #include "parser.hpp"
 #include "lexer.hpp"
+#include "threadpool.hpp"
 
 /**
  * コンストラクタ
+ * @param 入力ファイル名, 字句解析の方式
  */
-Parser::Parser(std::string filename){
-	Tokens = LexicalAnalysis(filename);
+Parser::Parser(std::string filename, LexMode mode)
+	: TU(NULL), Nodes(NULL), Symbols(&StringInterner::getGlobal()), Parent(NULL), CurDeclOffset(0), ReparsedTokenNum(0), ParsedArenaBytes(0){
+	Tokens = LexicalAnalysis(filename, mode);
+};
+
+/**
+ * コンストラクタ
+ * @param 字句解析済みのTokenStream（所有権を移す）
+ */
+Parser::Parser(TokenStream *tokens)
+	: TU(NULL), Nodes(NULL), Symbols(&StringInterner::getGlobal()), Parent(NULL), CurDeclOffset(0), ReparsedTokenNum(0), ParsedArenaBytes(0){
+	Tokens = tokens;
 };
 
 /**
  * 構文解析実行
+ * PARSE_PARALLELでも逐次切り出しの場合やスレッドが1つの場合は逐次に解析する
+ * DCC_PARSE_STATSを定義してビルドした場合は構文規則ごとの計測値を標準エラー出力に表示する
+ * @param 構文解析の方式
  * @return 解析成功:true 解析失敗:false
  */
-bool Parser::doParse(){
+bool Parser::doParse(ParseMode mode){
 	if(!Tokens){
 		fprintf(stderr, "error at lexer\n");
 		return false;
+	}
+
+	bool success;
+	if(mode == PARSE_PARALLEL && !Tokens->hasLexer() && ThreadPool::getHardwareThreads() > 1)
+		success = visitTranslationUnitParallel();
+	else
+		success = visitTranslationUnit();
+
+#ifdef DCC_PARSE_STATS
+	Stats.print(stderr);
+	Stats = ParseStats();
+#endif
+
+	if(!success || Tokens->hasLexError()){
+		// 逐次切り出しの場合は字句解析エラーが構文解析中に判明する
+		if(Tokens->hasLexError())
+			fprintf(stderr, "error at lexer\n");
+		return false;
 	}else{
-		return visitTranslationUnit();
+		ParsedArenaBytes = TU->getArena().getAllocatedBytes();
+		return true;
 	}
 };
 
@@ -38,102 +72,310 @@ TranslationUnitAST &Parser::getAST(){
  * @return 解析成功:true 解析失敗:false
  */
 bool Parser::visitTranslationUnit(){
-	// printnumの宣言追加
+	PARSER_RULE(RULE_TRANSLATION_UNIT);
 	TU = new TranslationUnitAST();
-	std::vector<std::string> param_list;
-	param_list.push_back("i");
-	TU->addPrototype(new PrototypeAST("printnum", param_list));
-	PrototypeTable["printnum"] = 1;
+	Nodes = &TU->getArena();
+	addPrintnumPrototype();
 	
 	//ExternalDecl
 	while(true){
-		if(!visitExternalDeclaration(TU)){
+		if(!visitExternalDeclaration(Decls)){
 			SAFE_DELETE(TU);
 			return false;
 		}
+		if(Decls.back().Func)
+			TU->addFunction(Decls.back().Func);
+		else
+			TU->addPrototype(Decls.back().Proto);
+
 		if (Tokens->getCurType() == TOK_EOF){
 			break;
 		}
 	}
+	return PARSER_RESULT(true);
+}
+
+/**
+ * printnumの宣言をTranslationUnitASTと関数名テーブルに追加する
+ */
+void Parser::addPrintnumPrototype(){
+	std::vector<int> param_list;
+	param_list.push_back(Symbols->intern("i"));
+	PrototypeAST *printnum = new (*Nodes) PrototypeAST(*Nodes, Symbols->intern("printnum"), param_list);
+	TU->addPrototype(printnum);
+	CurDeclOffset = -1;
+	addFunctionSymbol(PrototypeTable, printnum);
+}
+
+/**
+ * 並列構文解析で1つのタスクが解析する外部宣言の範囲
+ */
+struct ParseChunk{
+	int First;   // 先頭の外部宣言（Decls上の位置）
+	int Last;    // 末尾の外部宣言の次
+	std::vector<FunctionStmtAST*> Bodies; // 外部宣言ごとの関数本体（関数宣言はNULL）
+	Arena *Nodes; // 作業用Parserが関数本体のASTを確保する領域
+	bool Success;
+#ifdef DCC_PARSE_STATS
+	ParseStats Stats; // 作業用Parserの計測値
+#endif
+
+	ParseChunk() : First(0), Last(0), Nodes(NULL), Success(false){}
+};
+
+/**
+ * TranslationUnit用並列構文解析メソッド
+ * 外部宣言を先頭から順に見てプロトタイプを関数名テーブルに登録し、
+ * 関数本体は括弧の対応のみ確認して読み飛ばす
+ * その後、関数本体をスレッドプールで並列に解析し、ソース順にTranslationUnitASTへ追加する
+ * 関数名は宣言の位置で参照可否を判定するため、結果は逐次の解析と同一になる
+ * @return 解析成功:true 解析失敗:false
+ */
+bool Parser::visitTranslationUnitParallel(){
+	PARSER_RULE(RULE_TRANSLATION_UNIT_PARALLEL);
+	TU = new TranslationUnitAST();
+	Nodes = &TU->getArena();
+	addPrintnumPrototype();
+
+	// プロトタイプの登録と関数本体の位置の記録
+	std::vector<BodyRange> bodies; // 外部宣言ごとの関数本体のトークンの範囲
+	bool success = true;
+	while(success){
+		CurDeclOffset = Tokens->getCurOffset();
+		DeclRange decl;
+		decl.Begin = CurDeclOffset;
+		decl.Proto = NULL;
+		decl.Func = NULL;
+		BodyRange body = {-1, -1};
+
+		PrototypeAST *proto = visitPrototype();
+		if(!proto){
+			success = false;
+		}else if(Tokens->getCurType() == TOK_SEMICOLON){
+			if(decl.Proto = visitFunctionDeclaration(proto))
+				TU->addPrototype(proto);
+			else
+				success = false;
+		}else if(checkFunctionDefinition(proto)){
+			addFunctionSymbol(FunctionTable, proto);
+			decl.Proto = proto;
+			body.Begin = Tokens->getCurIndex();
+			success = skipFunctionBody();
+			body.End = Tokens->getCurIndex();
+		}else{
+			success = false;
+		}
+
+		if(decl.Proto){
+			decl.End = Tokens->getPrevEnd();
+			decl.EndLine = Tokens->getPrevLine();
+			Decls.push_back(decl);
+			bodies.push_back(body);
+		}
+		if(Tokens->getCurType() == TOK_EOF)
+			break;
+	}
+
+	// 外部宣言をトークン数がほぼ均等になるように分割して並列に解析
+	std::vector<ParseChunk> chunks;
+	if(success){
+		int num_threads = ThreadPool::getHardwareThreads();
+		long num_chunks = num_threads * 4;
+		long num_tokens = Tokens->getCurIndex();
+		ParseChunk chunk;
+		for(int i = 0; i < Decls.size(); i++){
+			if(chunk.Last > chunk.First && bodies[i].Begin >= 0 &&
+					bodies[i].Begin * num_chunks > (chunks.size() + 1) * num_tokens){
+				chunks.push_back(chunk);
+				chunk.First = i;
+			}
+			chunk.Last = i + 1;
+		}
+		chunks.push_back(chunk);
+
+		ThreadPool pool(num_threads);
+		for(int i = 0; i < chunks.size(); i++)
+			pool.addTask(std::bind(&Parser::parseFunctionBodies, this, &chunks[i], &bodies));
+		pool.wait();
+
+		for(int i = 0; i < chunks.size(); i++){
+			success = success && chunks[i].Success;
+#ifdef DCC_PARSE_STATS
+			Stats.merge(chunks[i].Stats);
+#endif
+		}
+	}
+
+	// 作業用のArenaをTranslationUnitASTに引き取り、ソース順に追加
+	// （失敗時は解析済みのASTもTranslationUnitASTと共に解放される）
+	for(int i = 0; i < chunks.size(); i++){
+		TU->getArena().adopt(*chunks[i].Nodes);
+		SAFE_DELETE(chunks[i].Nodes);
+		for(int j = chunks[i].First; success && j < chunks[i].Last; j++){
+			if(bodies[j].Begin < 0)
+				continue;
+			Decls[j].Func = new (*Nodes) FunctionAST(Decls[j].Proto, chunks[i].Bodies[j - chunks[i].First]);
+			TU->addFunction(Decls[j].Func);
+		}
+	}
+	if(!success){
+		Decls.clear();
+		SAFE_DELETE(TU);
+	}
+	return PARSER_RESULT(success);
+}
+
+/**
+ * 関数本体を括弧の対応のみ確認して読み飛ばす
+ * @return 成功:true 失敗:false
+ */
+bool Parser::skipFunctionBody(){
+	if(Tokens->getCurType() != TOK_LBRACE)
+		return false;
+
+	int depth = 0;
+	do{
+		if(Tokens->getCurType() == TOK_LBRACE)
+			depth++;
+		else if(Tokens->getCurType() == TOK_RBRACE)
+			depth--;
+		else if(Tokens->getCurType() == TOK_EOF)
+			return false;
+		Tokens->getNextToken();
+	}while(depth > 0);
 	return true;
 }
 
+/**
+ * 並列構文解析のタスク
+ * 分割内のトークンを作業用のTokenStreamに写し、作業用のParserで関数本体を解析する
+ * 関数名テーブルは元のParserのものを参照のみする
+ * （関数本体の識別子は字句解析時に登録済みのため、StringInternerも参照のみとなる）
+ * @param 解析する分割, 外部宣言ごとの関数本体のトークンの範囲
+ */
+void Parser::parseFunctionBodies(ParseChunk *chunk, const std::vector<BodyRange> *bodies){
+	chunk->Bodies.assign(chunk->Last - chunk->First, NULL);
+	chunk->Nodes = new Arena();
+	chunk->Success = true;
+
+	// 分割内の最初の関数本体から最後の関数本体までを写す
+	int begin = -1, end = -1;
+	for(int i = chunk->First; i < chunk->Last; i++){
+		if((*bodies)[i].Begin < 0)
+			continue;
+		if(begin < 0)
+			begin = (*bodies)[i].Begin;
+		end = (*bodies)[i].End;
+	}
+	if(begin < 0)
+		return;
+
+	TokenStream *tokens = new TokenStream();
+	tokens->setSource(Tokens->getSource());
+	tokens->copyTokens(*Tokens, begin, end);
+	tokens->pushToken(TOK_EOF, Decls[chunk->Last - 1].End, 0, 0x7fffffff, Decls[chunk->Last - 1].EndLine);
+
+	Parser worker(tokens);
+	worker.Parent = this;
+	worker.Nodes = chunk->Nodes;
+	for(int i = chunk->First; i < chunk->Last && chunk->Success; i++){
+		if((*bodies)[i].Begin < 0)
+			continue;
+		worker.CurDeclOffset = Decls[i].Begin;
+		worker.VariableTable.clear();
+		tokens->applyTokenIndex((*bodies)[i].Begin - begin);
+
+		// 読み飛ばしたときと同じ"}"で終わっていることを確認
+		FunctionStmtAST *body = worker.visitFunctionStatement(Decls[i].Proto);
+		if(body && tokens->getCurIndex() == (*bodies)[i].End - begin)
+			chunk->Bodies[i - chunk->First] = body;
+		else
+			chunk->Success = false;
+	}
+
+#ifdef DCC_PARSE_STATS
+	chunk->Stats = worker.Stats;
+#endif
+
+	// ソースは元のTokenStreamが所有する
+	tokens->setSource(NULL);
+}
+
 /**
  * ExternalDeclaration用構文解析クラス
- * @param TranslationUnitAST
- * @return true
- */
-bool Parser::visitExternalDeclaration(TranslationUnitAST *tunit){
-	// FunctionDeclaration
-	PrototypeAST *proto = visitFunctionDeclaration();
-	if (proto){
-		tunit->addPrototype(proto);
-		return true;
-	}
+ * プロトタイプを解析した後、次のトークンが";"であれば関数宣言、
+ * それ以外であれば関数定義として解析する
+ * @param 解析した外部宣言の追加先
+ * @return 解析成功:true 解析失敗:false
+ */
+bool Parser::visitExternalDeclaration(std::vector<DeclRange> &decls){
+	PARSER_RULE(RULE_EXTERNAL_DECLARATION);
+	// 外部宣言の範囲を記録し終えるまでトークンを解放しない
+	Tokens->setCheckpoint();
+	CurDeclOffset = Tokens->getCurOffset();
 
-	// FunctionDefinition
-	FunctionAST *func_def = visitFunctionDefinition();
-	if (func_def){
-		tunit->addFunction(func_def);
-		return true;
+	DeclRange decl;
+	decl.Begin = CurDeclOffset;
+	decl.Proto = NULL;
+	decl.Func = NULL;
+
+	PrototypeAST *proto = visitPrototype();
+	if(proto){
+		// FunctionDeclaration
+		if(Tokens->getCurType() == TOK_SEMICOLON){
+			decl.Proto = visitFunctionDeclaration(proto);
+
+		// FunctionDefinition
+		}else if(decl.Func = visitFunctionDefinition(proto)){
+			decl.Proto = decl.Func->getPrototype();
+		}
 	}
 
-	return false;
+	if (decl.Proto){
+		decl.End = Tokens->getPrevEnd();
+		decl.EndLine = Tokens->getPrevLine();
+		decls.push_back(decl);
+	}
+	Tokens->releaseCheckpoint();
+	return PARSER_RESULT(decl.Proto != NULL);
 }
 
 /**
  * FunctionDeclaration用構文解析メソッド
+ * @param 解析済みのプロトタイプ（失敗時は削除する）
  * @return 解析成功:PrototypeAST 解析失敗:NULL
  */
-PrototypeAST *Parser::visitFunctionDeclaration(){
-	int bkup = Tokens->getCurIndex();
-	PrototypeAST *proto = visitPrototype();
-	if (!proto)
-		return NULL;
-	
+PrototypeAST *Parser::visitFunctionDeclaration(PrototypeAST *proto){
+	PARSER_RULE(RULE_FUNCTION_DECLARATION);
 	// prototype
-	if (Tokens->getCurString() == ";"){
-		// 再定義されていない確認
-		if(PrototypeTable.find(proto->getName()) != PrototypeTable.end() ||
-				(FunctionTable.find(proto->getName()) != FunctionTable.end() &&
-				 FunctionTable[proto->getName()] != proto->getParamNum())){
-			// エラーメッセージを出してNULLを返す
-			fprintf(stderr, "Function : %s is redefined", proto->getName().c_str());
-			SAFE_DELETE(proto);
-			return NULL;
-		}
-		// （関数名, 引数）のペアをプロトタイプ宣言テーブル（Map）に追加
-		PrototypeTable[proto->getName()] = proto->getParamNum();
+	if (Tokens->getCurType() != TOK_SEMICOLON){
+		return NULL;
+	}
 
-		Tokens->getNextToken();
-		return proto;
-	}else{
-		SAFE_DELETE(proto);
-		Tokens->applyTokenIndex(bkup);
+	// 再定義されていない確認
+	int symbol = proto->getSymbol();
+	int func_param_num = lookupFunction(symbol);
+	if(lookupPrototype(symbol) >= 0 ||
+			(func_param_num >= 0 && func_param_num != proto->getParamNum())){
+		// エラーメッセージを出してNULLを返す
+		fprintf(stderr, "Function : %s is redefined", proto->getName().c_str());
 		return NULL;
 	}
+	// （関数名, 引数）のペアをプロトタイプ宣言テーブル（Map）に追加
+	addFunctionSymbol(PrototypeTable, proto);
+
+	Tokens->getNextToken();
+	return PARSER_RESULT(proto);
 }
 
 /**
  * FunctionDefinition用構文解析メソッド
+ * @param 解析済みのプロトタイプ（失敗時は削除する）
  * @return 解析成功:FunctionAST 解析失敗:NULL
  */
-FunctionAST *Parser::visitFunctionDefinition(){
-	int bkup = Tokens->getCurIndex();
-
-	PrototypeAST * proto = visitPrototype();
-	if(!proto){
-		return NULL;
-
-	// ここでプロトタイプ宣言と間違いないか
-	// すでに関数定義が行われていないか確認
-	}else if(PrototypeTable.find(proto->getName()) != PrototypeTable.end() &&
-			PrototypeTable[proto->getName()] != proto->getParamNum() ||
-			FunctionTable.find(proto->getName()) != FunctionTable.end()){
-
-		// エラーメッセージを出してNULLを返す
-		fprintf(stderr, "Function : %s is redefined", proto->getName().c_str());
-		SAFE_DELETE(proto);
+FunctionAST *Parser::visitFunctionDefinition(PrototypeAST *proto){
+	PARSER_RULE(RULE_FUNCTION_DEFINITION);
+	if(!checkFunctionDefinition(proto)){
 		return NULL;
 	}
 
@@ -141,26 +383,42 @@ FunctionAST *Parser::visitFunctionDefinition(){
 	FunctionStmtAST *func_stmt = visitFunctionStatement(proto);
 	if(func_stmt){
 		// ここで（関数名, 引数の数）のペアを関数テーブル（Map）に追加
-		FunctionTable[proto->getName()] = proto->getParamNum();
-		return new FunctionAST(proto, func_stmt);
+		addFunctionSymbol(FunctionTable, proto);
+		return PARSER_RESULT(new (*Nodes) FunctionAST(proto, func_stmt));
 	}else{
-		SAFE_DELETE(proto);
-		Tokens->applyTokenIndex(bkup);
 		return NULL;
 	}
 }
 
+/**
+ * 関数定義がプロトタイプ宣言と食い違っていないか、再定義でないか確認する
+ * @param 関数定義のプロトタイプ
+ * @return 問題なし:true 問題あり:false（エラーメッセージを表示する）
+ */
+bool Parser::checkFunctionDefinition(PrototypeAST *proto){
+	// ここでプロトタイプ宣言と間違いないか
+	// すでに関数定義が行われていないか確認
+	int symbol = proto->getSymbol();
+	if(lookupPrototype(symbol) >= 0 &&
+			lookupPrototype(symbol) != proto->getParamNum() ||
+			lookupFunction(symbol) >= 0){
+
+		// エラーメッセージを出してfalseを返す
+		fprintf(stderr, "Function : %s is redefined", proto->getName().c_str());
+		return false;
+	}
+	return true;
+}
+
 /** Prototype用構文解析メソッド
  * @return 解析成功:PrototypeAST 解析失敗:NULL;
  */
 PrototypeAST *Parser::visitPrototype(){
-	// bkup index
-	int bkup = Tokens->getCurIndex();
-
+	PARSER_RULE(RULE_PROTOTYPE);
 	// parameter_list
 	bool is_first_param = true;
-	std::string func_name;
-	std::vector<std::string> param_list;
+	int func_name;
+	std::vector<int> param_list;
 	
 	// type_specifier
 	if(Tokens->getCurType() == TOK_INT){
@@ -171,22 +429,21 @@ PrototypeAST *Parser::visitPrototype(){
 
 	// 関数名を取得
 	if(Tokens->getCurType() == TOK_IDENTIFIER){
-		func_name = Tokens->getCurString();
+		func_name = Tokens->getCurSymbol();
 		Tokens->getNextToken();
 	}else{
 		return NULL;
 	}
 	
 	// LEFT PAREN 
-	if(Tokens->getCurType() != TOK_SYMBOL || Tokens->getCurString() != "("){
-		Tokens->applyTokenIndex(bkup);
+	if(Tokens->getCurType() != TOK_LPAREN){
 		return NULL;
 	}
 	Tokens->getNextToken();
 
 	while(true){
 		// ,
-		if (!is_first_param && Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == ","){
+		if (!is_first_param && Tokens->getCurType() == TOK_COMMA){
 			Tokens->getNextToken();
 		}
 		if (Tokens->getCurType() == TOK_INT){
@@ -197,147 +454,115 @@ PrototypeAST *Parser::visitPrototype(){
 
 		if(Tokens->getCurType() == TOK_IDENTIFIER){
 			// 引数の変数名に重複がないか確認
-			if(std::find(param_list.begin(),param_list.end(), Tokens->getCurString()) != param_list.end()){
-				Tokens->applyTokenIndex(bkup);
+			if(std::find(param_list.begin(),param_list.end(), Tokens->getCurSymbol()) != param_list.end()){
 				return NULL;
 			}
 
-			param_list.push_back(Tokens->getCurString());
+			param_list.push_back(Tokens->getCurSymbol());
 			Tokens->getNextToken();
 		}else{
-			Tokens->applyTokenIndex(bkup);
 			return NULL;
 		}
 		is_first_param = false;
 	}
 
 	// RIGHT PAREN
-	if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == ")"){
+	if(Tokens->getCurType() == TOK_RPAREN){
 		Tokens->getNextToken();
-		return new PrototypeAST(func_name,param_list);
+		return PARSER_RESULT(new (*Nodes) PrototypeAST(*Nodes, func_name, param_list));
 	}else{
-		Tokens->applyTokenIndex(bkup);
 		return NULL;
 	}
 }
 
 /**
  * FunctionStatement用構文解析メソッド
+ * "int"で始まる間は変数宣言、それ以降は"}"まで文として解析する
  * @param 関数名や引数を格納したPrototypeクラスのインスタンス
  * @return 解析成功:FunctionStmtAST 解析失敗:NULL;
  */
 FunctionStmtAST *Parser::visitFunctionStatement(PrototypeAST *proto){
-	int bkup = Tokens->getCurIndex();
-
-	if(Tokens->getCurString() == "{"){
+	PARSER_RULE(RULE_FUNCTION_STATEMENT);
+	if(Tokens->getCurType() == TOK_LBRACE){
 		Tokens->getNextToken();
 	}else{
 		return NULL;
 	}
 
-	FunctionStmtAST *func_stmt = new FunctionStmtAST();
+	FunctionStmtAST *func_stmt = new (*Nodes) FunctionStmtAST(*Nodes);
 	
 	// 引数をfunc_stmtの変数宣言リストに追加
 	for(int i = 0; i < proto->getParamNum(); i++){
-		VariableDeclAST *vdecl = new VariableDeclAST(proto->getParamName(i));
+		VariableDeclAST *vdecl = new (*Nodes) VariableDeclAST(proto->getParamSymbol(i));
 		vdecl->setDeclType(VariableDeclAST::param);
 		func_stmt->addVariableDeclaration(vdecl);
-		VariableTable.push_back(vdecl->getName());
+		VariableTable.insert(vdecl->getSymbol(), vdecl);
 	}
 
-	VariableDeclAST *var_decl;
-	BaseAST *stmt;
-	BaseAST *last_stmt;
-	if(stmt = visitStatement()){
-		while(stmt){
-			last_stmt = stmt;
-			func_stmt->addStatement(stmt);
-			stmt = visitStatement();
+	// 変数宣言
+	while(Tokens->getCurType() == TOK_INT){
+		VariableDeclAST *var_decl = visitVariableDeclaration();
+		if(!var_decl){
+			return NULL;
 		}
-	}else if(var_decl = visitVariableDeclaration()){
-		while(var_decl){
-			var_decl->setDeclType(VariableDeclAST::local);
+		var_decl->setDeclType(VariableDeclAST::local);
 			
-			// 変数に重複がないか確認
-			if(std::find(VariableTable.begin(), VariableTable.end(), var_decl->getName()) != VariableTable.end()){
-				SAFE_DELETE(var_decl);
-				SAFE_DELETE(func_stmt);
-				return NULL;
-			}
-			//変数名テーブルに新しく読み取った変数目を追加
-			func_stmt->addVariableDeclaration(var_decl);
-			VariableTable.push_back(var_decl->getName());
-			var_decl = visitVariableDeclaration();
+		// 変数に重複がないか確認
+		int symbol = var_decl->getSymbol();
+		if(VariableTable.lookupCurrentScope(symbol)){
+			return NULL;
 		}
+		//変数名テーブルに新しく読み取った変数目を追加
+		func_stmt->addVariableDeclaration(var_decl);
+		VariableTable.insert(symbol, var_decl);
+	}
 
-		if(stmt = visitStatement()){
-			while(stmt){
-				last_stmt = stmt;
-				func_stmt->addStatement(stmt);
-				stmt = visitStatement();
-			}
+	// 文
+	BaseAST *last_stmt = NULL;
+	while(Tokens->getCurType() != TOK_RBRACE){
+		BaseAST *stmt = visitStatement();
+		if(!stmt){
+			return NULL;
 		}
-	// other
-	}else{
-		SAFE_DELETE(func_stmt);
-		Tokens->applyTokenIndex(bkup);
-		return NULL;
+		last_stmt = stmt;
+		func_stmt->addStatement(stmt);
 	}
 	
 	// 最後のStatementがjump_statementであるか確認
 	if(!last_stmt || !llvm::isa<JumpStmtAST>(last_stmt)){
-		SAFE_DELETE(func_stmt);
-		Tokens->applyTokenIndex(bkup);
 		return NULL;
 	}
 
-	if(Tokens->getCurString() == "}"){
-		Tokens->getNextToken();
-		return func_stmt;
-	}else{
-		SAFE_DELETE(func_stmt);
-		Tokens->applyTokenIndex(bkup);
-		return NULL;
-	}
+	// RIGHT BRACE
+	Tokens->getNextToken();
+	return PARSER_RESULT(func_stmt);
 }
 
 /**
  * AssignmentExpression用構文解析メソッド
+ * 宣言済みの変数の次のトークンが"="であれば代入式、それ以外は二項演算式として解析する
  * @return 解析成功:AST 解析失敗:NULL
  * 代入文の解析
  */
 BaseAST *Parser::visitAssignmentExpression(){
-	int bkup = Tokens->getCurIndex();
+	PARSER_RULE(RULE_ASSIGNMENT_EXPRESSION);
+	// 変数が宣言されているか確認
+	if(Tokens->getCurType() == TOK_IDENTIFIER &&
+			VariableTable.lookup(Tokens->getCurSymbol()) &&
+			Tokens->peekType() == TOK_ASSIGN){
+		BaseAST *lhs = new (*Nodes) VariableAST(Tokens->getCurSymbol());
+		Tokens->getNextToken();
+		Tokens->getNextToken();
 
-	BaseAST *lhs;
-	if(Tokens->getCurType() == TOK_IDENTIFIER){
-		// 変数が宣言されているか確認
-		if(std::find(VariableTable.begin(), VariableTable.end(), Tokens->getCurString()) != VariableTable.end()){
-			lhs = new VariableAST(Tokens->getCurString());
-			Tokens->getNextToken();
-			BaseAST *rhs;
-			if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "="){
-				Tokens->getNextToken();
-				if(rhs = visitAdditiveExpression(NULL)){
-					return new BinaryExprAST("=", lhs, rhs);
-				}else{
-					SAFE_DELETE(lhs);
-					Tokens->applyTokenIndex(bkup);
-				}
-			}else{
-				SAFE_DELETE(lhs);
-				Tokens->applyTokenIndex(bkup);
-			}
+		BaseAST *rhs = visitBinaryExpression();
+		if(rhs){
+			return PARSER_RESULT(new (*Nodes) BinaryExprAST(BINOP_ASSIGN, lhs, rhs));
 		}else{
-			Tokens->applyTokenIndex(bkup);
+			return NULL;
 		}
 	}
 
-	BaseAST *add_expr = visitAdditiveExpression(NULL);
-	if(add_expr){
-		return add_expr;
-	}
-	return NULL;
+	return PARSER_RESULT(visitBinaryExpression());
 }
 
 /**
@@ -345,26 +570,24 @@ BaseAST *Parser::visitAssignmentExpression(){
  * @return 解析成功時: AST失敗時:NULL
  */
 BaseAST *Parser::visitPrimaryExpression(){
-	// recored index
-	int bkup = Tokens->getCurIndex();
-
+	PARSER_RULE(RULE_PRIMARY_EXPRESSION);
 	// 変数が宣言されていることを確認
 	// VARIABLE_IDENTIFIER
 	if(Tokens->getCurType() == TOK_IDENTIFIER &&
-			(std::find(VariableTable.begin(), VariableTable.end(), Tokens->getCurString()) != VariableTable.end()) ){
+			VariableTable.lookup(Tokens->getCurSymbol())){
 		
-		std::string var_name = Tokens->getCurString();
+		int var_name = Tokens->getCurSymbol();
 		Tokens->getNextToken();
-		return new VariableAST(var_name);
+		return PARSER_RESULT(new (*Nodes) VariableAST(var_name));
 	
 	// integer
 	}else if(Tokens->getCurType() == TOK_DIGIT){
 		int val = Tokens->getCurNumVal();
 		Tokens->getNextToken();
-		return new NumberAST(val);
+		return PARSER_RESULT(new (*Nodes) NumberAST(val));
 	
 	// integer(-)
-	}else if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "-"){}
+	}else if(Tokens->getCurType() == TOK_MINUS){}
 
 
 	return NULL;
@@ -372,39 +595,31 @@ BaseAST *Parser::visitPrimaryExpression(){
 
 /**
  * PostfixExpression用構文解析メソッド
+ * 宣言済みの変数・数値以外の識別子は関数呼び出しとして解析する
  * @return 解析成功:AST 解析失敗:NULL
  */
 BaseAST *Parser::visitPostfixExpression(){
-	// ge index
-	int bkup = Tokens->getCurIndex();
-
-	BaseAST *prim_expr = visitPrimaryExpression();
-	if(prim_expr){
-		return prim_expr;
-	}
-	
+	PARSER_RULE(RULE_POSTFIX_EXPRESSION);
 	// FUNCTION_IDENTIFIER
-	if(Tokens->getCurType() == TOK_IDENTIFIER){
+	if(Tokens->getCurType() == TOK_IDENTIFIER &&
+			!VariableTable.lookup(Tokens->getCurSymbol())){
 		int param_num;
 		// プロトタイプ宣言されているか確認し、引数の数をテーブルから取得
-		if(PrototypeTable.find(Tokens->getCurString()) != PrototypeTable.end() ){
-			param_num = PrototypeTable[Tokens->getCurString()];
+		if((param_num = lookupPrototype(Tokens->getCurSymbol())) >= 0){
 
 		//関数定義済みであるか確認し、引数の数をテーブルから取得
-		}else if(FunctionTable.find(Tokens->getCurString()) != FunctionTable.end()){
-			param_num = FunctionTable[Tokens->getCurString()];
+		}else if((param_num = lookupFunction(Tokens->getCurSymbol())) >= 0){
 		}else{
 			return NULL;
 		}
 
 
 		// 関数名取得
-		std::string Callee = Tokens->getCurString();
+		int Callee = Tokens->getCurSymbol();
 		Tokens->getNextToken();
 
 		// LEFT PAREN
-		if(Tokens->getCurType() != TOK_SYMBOL || Tokens->getCurString() != "("){
-			Tokens->applyTokenIndex(bkup);
+		if(Tokens->getCurType() != TOK_LPAREN){
 			return NULL;
 		}
 
@@ -415,7 +630,7 @@ BaseAST *Parser::visitPostfixExpression(){
 		if(assign_expr){
 			args.push_back(assign_expr);
 			// ","が続く限り繰り返し
-			while(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == ","){
+			while(Tokens->getCurType() == TOK_COMMA){
 				Tokens->getNextToken();
 				
 				// IDENTIFIER
@@ -430,72 +645,98 @@ BaseAST *Parser::visitPostfixExpression(){
 		
 		// 引数の数を確認
 		if(args.size() != param_num){
-			for(int i=0;i<args.size();i++){
-				SAFE_DELETE(args[i]);
-			}
-			Tokens->applyTokenIndex(bkup);
 			return NULL;
 		}
 
 		// Right PaLen
-		if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == ")"){
+		if(Tokens->getCurType() == TOK_RPAREN){
 			Tokens->getNextToken();
-			return new CallExprAST(Callee,args);
+			return PARSER_RESULT(new (*Nodes) CallExprAST(*Nodes, Callee, args));
 		}else{
-			for(int i=0;i<args.size();i++){
-				SAFE_DELETE(args[i]);
-			}
-			Tokens->applyTokenIndex(bkup);
 			return NULL;
 		}
-	}else{
-		return NULL;
 	}
+
+	return PARSER_RESULT(visitPrimaryExpression());
 }
 
 /**
- * AdditiveExpression用構文解析メソッド
- * @param lhs（左辺）。初回呼び出しはNULL
- * @return 解析成功:AST 解析失敗:NULL
+ * 二項演算子の表
+ * 優先順位は値が大きいほど強く結合する（いずれも左結合）
  */
-BaseAST *Parser::visitAdditiveExpression(BaseAST *lhs){
-	// bkup index
-	int bkup = Tokens->getCurIndex();
+static const BinaryOperator BinaryOperators[] = {
+	{TOK_PLUS,  BINOP_ADD, 1},
+	{TOK_MINUS, BINOP_SUB, 1},
+	{TOK_STAR,  BINOP_MUL, 2},
+	{TOK_SLASH, BINOP_DIV, 2}
+};
 
-	if(!lhs){
-		lhs = visitMultiplicativeExpression(NULL);
+/**
+ * トークン種別に対応する二項演算子を取得する
+ * @param トークン種別
+ * @return 二項演算子の場合:表の要素 それ以外:NULL
+ */
+static const BinaryOperator *getBinaryOperator(TokenType type){
+	for(int i = 0; i < sizeof(BinaryOperators) / sizeof(BinaryOperators[0]); i++){
+		if(BinaryOperators[i].Type == type)
+			return &BinaryOperators[i];
 	}
+	return NULL;
+}
 
-	if(!lhs){
-		return NULL;
-	}
+/**
+ * 二項演算式（AdditiveExpression, MultiplicativeExpression）用構文解析メソッド
+ * 演算子の表の優先順位に従い、被演算子と演算子のスタックを使って
+ * 再帰せずに左結合の木を組み立てる（優先順位の登り方式）
+ * スタックは入れ子の式（関数呼び出しの引数）と共有し、呼び出し時の高さより上のみ使う
+ * @return 解析成功:AST 解析失敗:NULL
+ */
+BaseAST *Parser::visitBinaryExpression(){
+	PARSER_RULE(RULE_BINARY_EXPRESSION);
+	int operand_base = OperandStack.size();
+	int operator_base = OperatorStack.size();
 
-	BaseAST *rhs;
-	// +
-	if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "+"){
-		Tokens->getNextToken();
-		rhs = visitMultiplicativeExpression(NULL);
-		if(rhs){
-			return visitAdditiveExpression(new BinaryExprAST("+", lhs, rhs));
-		}else{
-			SAFE_DELETE(lhs);
-			Tokens->applyTokenIndex(bkup);
-			return NULL;
+	BaseAST *operand = visitPostfixExpression();
+	while(operand){
+		OperandStack.push_back(operand);
+
+		const BinaryOperator *op = getBinaryOperator(Tokens->getCurType());
+		if(!op)
+			break;
+
+		// 優先順位が同じか高い演算子を先に左辺としてまとめる
+		while(OperatorStack.size() > operator_base &&
+				OperatorStack.back()->Precedence >= op->Precedence){
+			reduceBinaryExpression();
 		}
-	
-	// -
-	}else if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "-"){
+		OperatorStack.push_back(op);
 		Tokens->getNextToken();
-		rhs = visitMultiplicativeExpression(NULL);
-		if(rhs){
-			return visitAdditiveExpression(new BinaryExprAST("-", lhs, rhs));
-		}else{
-			SAFE_DELETE(lhs);
-			Tokens->applyTokenIndex(bkup);
-			return NULL;
-		}
+		operand = visitPostfixExpression();
 	}
-	return lhs;
+
+	// 右辺が解析できなかった場合は組み立て途中の式を捨てる（領域はArenaの破棄時に解放される）
+	if(!operand){
+		OperandStack.resize(operand_base);
+		OperatorStack.resize(operator_base);
+		return NULL;
+	}
+
+	while(OperatorStack.size() > operator_base)
+		reduceBinaryExpression();
+	BaseAST *expr = OperandStack.back();
+	OperandStack.pop_back();
+	return PARSER_RESULT(expr);
+}
+
+/**
+ * スタック最上段の演算子と2つの被演算子をBinaryExprASTにまとめる
+ */
+void Parser::reduceBinaryExpression(){
+	BaseAST *rhs = OperandStack.back();
+	OperandStack.pop_back();
+	BaseAST *lhs = OperandStack.back();
+	OperandStack.back() = new (*Nodes) BinaryExprAST(OperatorStack.back()->Op, lhs, rhs);
+	OperatorStack.pop_back();
 }
 
 /**
@@ -503,16 +744,17 @@ BaseAST *Parser::visitAdditiveExpression(BaseAST *lhs){
  * @return 解析成功:AST 解析失敗:NULL
  */
 BaseAST *Parser::visitExpressionStatement(){
+	PARSER_RULE(RULE_EXPRESSION_STATEMENT);
 	BaseAST *assign_expr;
 
 	// NULL Expression
-	if(Tokens->getCurString() == ";"){
+	if(Tokens->getCurType() == TOK_SEMICOLON){
 		Tokens->getNextToken();
-		return new NullExprAST();
+		return PARSER_RESULT(new (*Nodes) NullExprAST());
 	}else if(assign_expr = visitAssignmentExpression()){
-		if(Tokens->getCurString() == ";"){
+		if(Tokens->getCurType() == TOK_SEMICOLON){
 			Tokens->getNextToken();
-			return assign_expr;
+			return PARSER_RESULT(assign_expr);
 		}
 	}
 	return NULL;
@@ -523,13 +765,11 @@ BaseAST *Parser::visitExpressionStatement(){
  * @return 解析成功:AST 解析失敗:NULL
  */
 BaseAST *Parser::visitStatement(){
-	BaseAST *stmt = NULL;
-	if(stmt = visitExpressionStatement()){
-		return stmt;
-	}else if(stmt = visitJumpStatement()){
-		return stmt;
+	PARSER_RULE(RULE_STATEMENT);
+	if(Tokens->getCurType() == TOK_RETURN){
+		return PARSER_RESULT(visitJumpStatement());
 	}else{
-		return NULL;
+		return PARSER_RESULT(visitExpressionStatement());
 	}
 }
 
@@ -538,7 +778,8 @@ BaseAST *Parser::visitStatement(){
  * @return 解析成功:VariableeclAST 解析失敗:NULL
  */
 VariableDeclAST *Parser::visitVariableDeclaration(){
-	std::string name;
+	PARSER_RULE(RULE_VARIABLE_DECLARATION);
+	int name;
 
 	if(Tokens->getCurType() == TOK_INT){
 		Tokens->getNextToken();
@@ -547,60 +788,18 @@ VariableDeclAST *Parser::visitVariableDeclaration(){
 	}
 
 	if(Tokens->getCurType() == TOK_IDENTIFIER){
-		name = Tokens->getCurString();
+		name = Tokens->getCurSymbol();
 		Tokens->getNextToken();
 	}else{
-		Tokens->ungetToken(1);
 		return NULL;
 	}
 
-	if(Tokens->getCurString() == ";"){
+	if(Tokens->getCurType() == TOK_SEMICOLON){
 		Tokens->getNextToken();
-		return new VariableDeclAST(name);
+		return PARSER_RESULT(new (*Nodes) VariableDeclAST(name));
 	}else{
-		Tokens->ungetToken(2);
-		return NULL;
-	}
-}
-
-/**
- * MultiplicativeExpression用解析メソッド
- * @return 解析成功:AST 解析失敗:NULL
- */
-BaseAST *Parser::visitMultiplicativeExpression(BaseAST *lhs){
-	int bkup = Tokens->getCurIndex();
-
-	if(!lhs){
-		lhs = visitPostfixExpression();
-	}
-	BaseAST *rhs;
-
-	if(!lhs){
 		return NULL;
 	}
-
-	if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "*"){
-		Tokens->getNextToken();
-		rhs = visitPostfixExpression();
-		if(rhs){
-			return visitMultiplicativeExpression(new BinaryExprAST("*", lhs, rhs));
-		}else{
-			SAFE_DELETE(lhs);
-			Tokens->applyTokenIndex(bkup);
-			return NULL;
-		}
-	}else if(Tokens->getCurType() == TOK_SYMBOL && Tokens->getCurString() == "/"){
-		Tokens->getNextToken();
-		rhs = visitPostfixExpression();
-		if(rhs){
-			return visitMultiplicativeExpression(new BinaryExprAST("/", lhs, rhs));
-		}else{
-			SAFE_DELETE(lhs);
-			Tokens->applyTokenIndex(bkup);
-			return NULL;
-		}
-	}
-	return lhs;
 }
 
 /**
@@ -608,24 +807,210 @@ BaseAST *Parser::visitMultiplicativeExpression(BaseAST *lhs){
  * @return 解析成功:JumpStmtAST 解析失敗:NULL
  */
 BaseAST *Parser::visitJumpStatement(){
-	int bkup = Tokens->getCurIndex();
+	PARSER_RULE(RULE_JUMP_STATEMENT);
 	BaseAST *expr;
 
 	if(Tokens->getCurType() == TOK_RETURN){
 		Tokens->getNextToken();
 		if(!(expr = visitAssignmentExpression())){
-			Tokens->applyTokenIndex(bkup);
 			return NULL;
 		}
 
-		if(Tokens->getCurString() == ";"){
+		if(Tokens->getCurType() == TOK_SEMICOLON){
 			Tokens->getNextToken();
-			return new JumpStmtAST(expr);
+			return PARSER_RESULT(new (*Nodes) JumpStmtAST(expr));
 		}else{
-			Tokens->applyTokenIndex(bkup);
 			return NULL;
 		}
 	}else{
 		return NULL;
 	}
 }
+
+
+/**
+ * 解析中の外部宣言から参照できるプロトタイプ宣言を検索する
+ * @param 関数名のシンボル番号
+ * @return 宣言されている場合:引数の数 宣言されていない場合:-1
+ */
+int Parser::lookupPrototype(int symbol){
+	FunctionSymbol *func = (Parent ? Parent : this)->PrototypeTable.lookup(symbol);
+	if(!func || func->DeclOffset >= CurDeclOffset)
+		return -1;
+	return func->ParamNum;
+}
+
+/**
+ * 解析中の外部宣言から参照できる関数定義を検索する
+ * @param 関数名のシンボル番号
+ * @return 定義されている場合:引数の数 定義されていない場合:-1
+ */
+int Parser::lookupFunction(int symbol){
+	FunctionSymbol *func = (Parent ? Parent : this)->FunctionTable.lookup(symbol);
+	if(!func || func->DeclOffset >= CurDeclOffset)
+		return -1;
+	return func->ParamNum;
+}
+
+/**
+ * 関数名テーブルに解析中の外部宣言で宣言した関数を追加する
+ * @param 追加先のテーブル, 関数宣言
+ */
+void Parser::addFunctionSymbol(SymbolTable<FunctionSymbol> &table, PrototypeAST *proto){
+	FunctionSymbol symbol;
+	symbol.ParamNum = proto->getParamNum();
+	symbol.DeclOffset = CurDeclOffset;
+	table.insert(proto->getSymbol(), symbol);
+}
+
+/**
+ * ソース全体を再解析する
+ * @param 新しいソース（所有権を移す）
+ * @return 解析成功:true 解析失敗:false
+ */
+bool Parser::reparseAll(SourceBuffer *source){
+	SAFE_DELETE(TU);
+	SAFE_DELETE(Tokens);
+	PrototypeTable.clear();
+	FunctionTable.clear();
+	Decls.clear();
+
+	Tokens = LexicalAnalysis(source);
+	if(Tokens)
+		ReparsedTokenNum = Tokens->size();
+	return doParse();
+}
+
+/**
+ * 再解析メソッド
+ * ソースの[edit_begin, old_end)が[edit_begin, new_end)に置き換えられたとき、
+ * 編集箇所に接する外部宣言とその間の範囲のみ字句解析・構文解析し直し、
+ * それ以外の外部宣言のASTはそのまま再利用する
+ * 再解析した範囲で宣言される関数名・引数の数が変わった場合は後続の宣言の
+ * 解析結果が変わりうるため、ソース全体を再解析する
+ * 置き換えたASTの領域はArenaに残るため、Arenaが全体を解析した直後の2倍を超えた場合も
+ * ソース全体を再解析して解放する
+ * @param 編集後のソース全体, バイト数, 編集の開始位置, 編集前の終了位置, 編集後の終了位置
+ * @return 解析成功:true 解析失敗:false
+ */
+bool Parser::reparse(const char *source, int size, int edit_begin, int old_end, int new_end){
+	SourceBuffer *new_source = SourceBuffer::copy(source, size);
+	if(!TU || !Tokens || TU->getArena().getAllocatedBytes() > ParsedArenaBytes * 2)
+		return reparseAll(new_source);
+	Nodes = &TU->getArena();
+
+	SourceBuffer *old_source = Tokens->getSource();
+	int delta = new_end - old_end;
+
+	// 編集箇所に接する外部宣言[first, last]を求める
+	int first = 0;
+	while(first < Decls.size() && Decls[first].End < edit_begin)
+		first++;
+	int last = first - 1;
+	while(last + 1 < Decls.size() && Decls[last + 1].Begin <= old_end)
+		last++;
+
+	// 再解析する範囲（前後の外部宣言の間）
+	int region_begin = first > 0 ? Decls[first - 1].End : 0;
+	int region_line = first > 0 ? Decls[first - 1].EndLine : 0;
+	int old_region_end = last + 1 < Decls.size() ? Decls[last + 1].Begin : old_source->getSize();
+	int new_region_end = old_region_end + delta;
+
+	// 範囲の末尾が後続のトークンと繋がる場合は全体を再解析
+	const char *text = new_source->getBegin();
+	if(new_region_end > region_begin && new_region_end < size &&
+			isalnum((unsigned char)text[new_region_end - 1]) &&
+			isalnum((unsigned char)text[new_region_end])){
+		return reparseAll(new_source);
+	}
+
+	// 行数のずれ（旧ソースはTokensと共に解放されるため先に求める）
+	int line_delta = std::count(text + edit_begin, text + new_end, '\n') -
+		std::count(old_source->getBegin() + edit_begin, old_source->getBegin() + old_end, '\n');
+
+	// 範囲のみ字句解析（コメントが範囲外まで続く場合は全体を再解析）
+	TokenStream *tokens = new TokenStream();
+	tokens->setSource(new_source);
+	Lexer lex(new_source, text + region_begin, text + new_region_end, false, region_line);
+	bool lexed = LexicalAnalysis(&lex, tokens);
+	if(lexed && (lex.isInComment() || (lex.isInLineComment() && new_region_end < size))){
+		tokens->setSource(NULL);
+		SAFE_DELETE(tokens);
+		return reparseAll(new_source);
+	}
+	ReparsedTokenNum = tokens->size();
+	SAFE_DELETE(Tokens);
+	Tokens = tokens;
+	if(!lexed){
+		SAFE_DELETE(TU);
+		return false;
+	}
+
+	// 関数名テーブルを範囲外の外部宣言から作り直す（後続の宣言は位置をずらす）
+	PrototypeTable.clear();
+	FunctionTable.clear();
+	CurDeclOffset = -1;
+	addFunctionSymbol(PrototypeTable, TU->getPrototype(0));
+	for(int i = 0; i < Decls.size(); i++){
+		if(i >= first && i <= last)
+			continue;
+		CurDeclOffset = i < first ? Decls[i].Begin : Decls[i].Begin + delta;
+		addFunctionSymbol(Decls[i].Func ? FunctionTable : PrototypeTable, Decls[i].Proto);
+	}
+
+	// 範囲内の外部宣言を解析
+	// （前後の宣言は変わらないため、ここで失敗すればソース全体でも失敗する）
+	std::vector<DeclRange> new_decls;
+	bool success = true;
+	while(Tokens->getCurType() != TOK_EOF){
+		if(!visitExternalDeclaration(new_decls)){
+			success = false;
+			break;
+		}
+	}
+
+	// 宣言される関数名・引数の数が変わっていないか確認
+	bool same_symbols = success && new_decls.size() == last - first + 1;
+	for(int i = 0; same_symbols && i < new_decls.size(); i++){
+		PrototypeAST *old_proto = Decls[first + i].Proto;
+		PrototypeAST *new_proto = new_decls[i].Proto;
+		same_symbols = (Decls[first + i].Func == NULL) == (new_decls[i].Func == NULL) &&
+			old_proto->getSymbol() == new_proto->getSymbol() &&
+			old_proto->getParamNum() == new_proto->getParamNum();
+	}
+
+	if(!same_symbols){
+		if(!success){
+			SAFE_DELETE(TU);
+			return false;
+		}
+		// 新しいソースの所有権をTokensから移して全体を再解析
+		Tokens->setSource(NULL);
+		return reparseAll(new_source);
+	}
+
+	// TranslationUnitAST内のASTを置き換える（先頭はprintnumの宣言）
+	int proto_index = 1, func_index = 0;
+	for(int i = 0; i < first; i++){
+		if(Decls[i].Func)
+			func_index++;
+		else
+			proto_index++;
+	}
+	for(int i = 0; i < new_decls.size(); i++){
+		if(new_decls[i].Func)
+			TU->replaceFunction(func_index++, new_decls[i].Func);
+		else
+			TU->replacePrototype(proto_index++, new_decls[i].Proto);
+	}
+
+	// 後続の外部宣言の位置をずらして範囲を置き換え
+	for(int i = last + 1; i < Decls.size(); i++){
+		Decls[i].Begin += delta;
+		Decls[i].End += delta;
+		Decls[i].EndLine += line_delta;
+	}
+	Decls.erase(Decls.begin() + first, Decls.begin() + last + 1);
+	Decls.insert(Decls.begin() + first, new_decls.begin(), new_decls.end());
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "parsestats.hpp"
+
+#ifdef DCC_PARSE_STATS
+
+#include <cstring>
+#include <sys/time.h>
+#include "lexer.hpp"
+
+/**
+ * 構文規則名（ParseRuleの順）
+ */
+static const char *RuleNames[RULE_NUM] = {
+	"TranslationUnit",
+	"TranslationUnitParallel",
+	"ExternalDeclaration",
+	"FunctionDeclaration",
+	"FunctionDefinition",
+	"Prototype",
+	"FunctionStatement",
+	"VariableDeclaration",
+	"Statement",
+	"ExpressionStatement",
+	"JumpStatement",
+	"AssignmentExpression",
+	"BinaryExpression",
+	"PostfixExpression",
+	"PrimaryExpression"
+};
+
+/**
+ * 現在時刻を秒で取得
+ */
+static double getTime(){
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+/**
+ * コンストラクタ
+ */
+ParseStats::ParseStats(){
+	memset(Rules, 0, sizeof(Rules));
+}
+
+/**
+ * 別の計測値を加算する
+ * @param 加算する計測値
+ */
+void ParseStats::merge(const ParseStats &stats){
+	for(int i = 0; i < RULE_NUM; i++){
+		Rules[i].Calls += stats.Rules[i].Calls;
+		Rules[i].Successes += stats.Rules[i].Successes;
+		Rules[i].Failures += stats.Rules[i].Failures;
+		Rules[i].Rewinds += stats.Rules[i].Rewinds;
+		Rules[i].Consumed += stats.Rules[i].Consumed;
+		Rules[i].Reconsumed += stats.Rules[i].Reconsumed;
+		Rules[i].Time += stats.Rules[i].Time;
+	}
+}
+
+/**
+ * 計測値を表形式で出力する（呼び出されなかった規則は省略）
+ * 時間・トークン数は入れ子の規則の分を含む
+ * @param 出力先
+ */
+void ParseStats::print(FILE *out){
+	fprintf(out, "%-24s %10s %10s %10s %8s %12s %10s %10s\n",
+			"rule", "calls", "success", "failure", "rewinds", "consumed", "reconsumed", "time(ms)");
+	for(int i = 0; i < RULE_NUM; i++){
+		ParseRuleStats &rule = Rules[i];
+		if(rule.Calls == 0)
+			continue;
+		fprintf(out, "%-24s %10ld %10ld %10ld %8ld %12ld %10ld %10.3f\n",
+				RuleNames[i], rule.Calls, rule.Successes, rule.Failures,
+				rule.Rewinds, rule.Consumed, rule.Reconsumed, rule.Time * 1e3);
+	}
+}
+
+/**
+ * コンストラクタ
+ * @param 加算先の計測値, 構文規則, 解析中のTokenStream
+ */
+ParseRuleScope::ParseRuleScope(ParseStats &stats, ParseRule rule, TokenStream *tokens)
+	: Stats(stats.getRule(rule)), Tokens(tokens), Success(false){
+	MaxIndex = Tokens->getMaxIndex();
+	Reconsumed = Tokens->getReconsumedTokenNum();
+	Rewinds = Tokens->getRewindNum();
+	Start = getTime();
+}
+
+/**
+ * デストラクタ
+ * 読み進めたトークン数は、新たに到達したトークン数と読み直したトークン数の和
+ */
+ParseRuleScope::~ParseRuleScope(){
+	int reconsumed = Tokens->getReconsumedTokenNum() - Reconsumed;
+	Stats.Calls++;
+	if(Success)
+		Stats.Successes++;
+	else
+		Stats.Failures++;
+	Stats.Rewinds += Tokens->getRewindNum() - Rewinds;
+	Stats.Consumed += Tokens->getMaxIndex() - MaxIndex + reconsumed;
+	Stats.Reconsumed += reconsumed;
+	Stats.Time += getTime() - Start;
+}
+
+#endif
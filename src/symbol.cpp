@@ -0,0 +1,91 @@
+#include <cstring>
+#include "symbol.hpp"
+
+/**
+ * 文字列のハッシュ値（FNV-1a）
+ * @param 文字列, バイト数
+ * @return ハッシュ値
+ */
+static unsigned int hashString(const char *str, int length){
+	unsigned int hash = 2166136261u;
+	for(int i = 0; i < length; i++){
+		hash ^= (unsigned char)str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * 文字列が入っている、または入るべきバケットを探す
+ * @param 文字列, バイト数, ハッシュ値
+ * @return バケットの位置
+ */
+int StringInterner::findBucket(const char *str, int length, unsigned int hash){
+	int mask = Buckets.size() - 1;
+	int i = hash & mask;
+	while(Buckets[i] >= 0){
+		int symbol = Buckets[i];
+		if(Hashes[symbol] == hash && Strings[symbol].size() == length &&
+				memcmp(Strings[symbol].data(), str, length) == 0)
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/**
+ * バケット数を2倍にして登録済みの文字列を入れ直す
+ */
+void StringInterner::rehash(){
+	Buckets.assign(Buckets.size() * 2, -1);
+	int mask = Buckets.size() - 1;
+	for(int symbol = 0; symbol < Strings.size(); symbol++){
+		int i = Hashes[symbol] & mask;
+		while(Buckets[i] >= 0)
+			i = (i + 1) & mask;
+		Buckets[i] = symbol;
+	}
+}
+
+/**
+ * 文字列のシンボル番号を取得する（未登録の場合は登録する）
+ * @param 文字列, バイト数
+ * @return シンボル番号
+ */
+int StringInterner::intern(const char *str, int length){
+	unsigned int hash = hashString(str, length);
+	int i = findBucket(str, length, hash);
+	if(Buckets[i] >= 0)
+		return Buckets[i];
+
+	// 使用率が1/2を超えないように拡張
+	int symbol = Strings.size();
+	Strings.push_back(std::string(str, length));
+	Hashes.push_back(hash);
+	if(Strings.size() * 2 > Buckets.size()){
+		rehash();
+	}else{
+		Buckets[i] = symbol;
+	}
+	return symbol;
+}
+
+/**
+ * 登録済みの文字列のシンボル番号を取得する
+ * @param 文字列, バイト数
+ * @return 登録済みの場合:シンボル番号 未登録の場合:-1
+ */
+int StringInterner::find(const char *str, int length){
+	return Buckets[findBucket(str, length, hashString(str, length))];
+}
+
+/**
+ * 字句解析・構文解析で共有するStringInternerを取得する
+ * 並列に字句解析する場合は分割ごとのStringInternerに登録し、
+ * 連結時にこちらのシンボル番号に置き換える
+ * @return StringInterner
+ */
+StringInterner &StringInterner::getGlobal(){
+	static StringInterner interner;
+	return interner;
+}
@@ -0,0 +1,84 @@
+#include "threadpool.hpp"
+
+/**
+ * コンストラクタ
+ * @param スレッド数（0の場合はハードウェアのスレッド数）
+ */
+ThreadPool::ThreadPool(int num_threads) : Running(0), Stop(false){
+	if(num_threads <= 0)
+		num_threads = getHardwareThreads();
+	for(int i = 0; i < num_threads; i++)
+		Workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+/**
+ * デストラクタ
+ * 残っているタスクを実行し終えてからスレッドを終了する
+ */
+ThreadPool::~ThreadPool(){
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stop = true;
+	}
+	TaskCond.notify_all();
+	for(int i = 0; i < Workers.size(); i++)
+		Workers[i].join();
+}
+
+/**
+ * タスク追加
+ * @param 実行するタスク
+ */
+void ThreadPool::addTask(const std::function<void()> &task){
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Tasks.push_back(task);
+	}
+	TaskCond.notify_one();
+}
+
+/**
+ * 全タスクの完了待ち
+ */
+void ThreadPool::wait(){
+	std::unique_lock<std::mutex> lock(Mutex);
+	while(!Tasks.empty() || Running > 0)
+		DoneCond.wait(lock);
+}
+
+/**
+ * ハードウェアのスレッド数取得
+ * @return スレッド数（取得できない場合は1）
+ */
+int ThreadPool::getHardwareThreads(){
+	int num = std::thread::hardware_concurrency();
+	return num > 0 ? num : 1;
+}
+
+/**
+ * ワーカスレッドの処理
+ */
+void ThreadPool::workerLoop(){
+	while(true){
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			while(!Stop && Tasks.empty())
+				TaskCond.wait(lock);
+			if(Tasks.empty())
+				return;
+			task = Tasks.front();
+			Tasks.pop_front();
+			Running++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Running--;
+			if(Tasks.empty() && Running == 0)
+				DoneCond.notify_all();
+		}
+	}
+}
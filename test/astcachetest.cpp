@@ -0,0 +1,183 @@
+/**
+ * ASTCacheのテスト
+ *
+ * 使い方:
+ *   astcachetest
+ *   キャッシュに書き込んだファイルを切り詰め・書き換えてから読み込み、
+ *   壊れたキャッシュが読み込みの失敗（キャッシュミス）になるか確かめる
+ *   （失敗したケースを表示し、終了コード1で終わる）
+ *
+ * ビルド:
+ *   g++ -O2 -Iinc `llvm-config --cxxflags` -o astcachetest test/astcachetest.cpp \
+ *       src/lexer.cpp src/charscan.cpp src/threadpool.cpp src/symbol.cpp src/parsestats.cpp src/arena.cpp \
+ *       src/parser.cpp src/AST.cpp src/flatast.cpp src/astcache.cpp -lpthread
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "parser.hpp"
+#include "flatast.hpp"
+#include "astcache.hpp"
+
+static const char *Source =
+	"int f(int a){\n\treturn a;\n}\n"
+	"int main(){\n\tint x;\n\tx = f(1);\n\treturn x + 2;\n}\n";
+
+/**
+ * キャッシュファイルの内容の書き換え方
+ */
+enum Corruption{
+	NONE,            // 書き換えない
+	TRUNCATE,        // 末尾を切り詰める
+	VARIABLE_NAME,   // 変数参照を関数名に書き換える
+	CALLEE_NAME,     // 呼び出し先を変数名に書き換える
+	CALL_ARG_NUM,    // 呼び出しの引数の数を書き換える
+	NULL_OPERAND,    // 二項演算の右辺を空の式に書き換える
+	NESTED_RETURN    // 代入の右辺の呼び出しをreturnに書き換える
+};
+
+/**
+ * ファイルの内容を読む
+ * @param ファイル名
+ * @return 内容
+ */
+static std::string readFile(const std::string &file_name){
+	std::string data;
+	FILE *fp = fopen(file_name.c_str(), "rb");
+	if(!fp)
+		return data;
+	char buf[4096];
+	size_t size;
+	while((size = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.append(buf, size);
+	fclose(fp);
+	return data;
+}
+
+/**
+ * ファイルに書き出す
+ * @param ファイル名, 内容
+ */
+static void writeFile(const std::string &file_name, const std::string &data){
+	FILE *fp = fopen(file_name.c_str(), "wb");
+	fwrite(data.data(), 1, data.size(), fp);
+	fclose(fp);
+}
+
+/**
+ * ファイル内の通し番号で文字列を探す
+ * @param キャッシュファイルの内容, 先頭, 探す文字列
+ * @return 通し番号（無ければ-1）
+ */
+static int findString(const std::string &data, const ASTCacheHeader &header, const char *str){
+	size_t offsets_begin = sizeof(header) + header.NodeNum * sizeof(FlatNode) +
+		header.StmtNum * sizeof(unsigned int) + header.VarNum * sizeof(int) +
+		(header.PrototypeNum + header.FunctionNum) * sizeof(FlatFunction);
+	const unsigned int *offsets = (const unsigned int*)(data.data() + offsets_begin);
+	const char *strings = (const char*)(offsets + header.StringNum + 1);
+	for(int i = 0; i < header.StringNum; i++)
+		if(offsets[i + 1] - offsets[i] == strlen(str) && memcmp(strings + offsets[i], str, strlen(str)) == 0)
+			return i;
+	return -1;
+}
+
+/**
+ * キャッシュファイルを書き換える
+ * @param キャッシュファイルの内容, 書き換え方
+ */
+static void corrupt(std::string &data, Corruption corruption){
+	if(corruption == TRUNCATE){
+		data.resize(data.size() - 4);
+		return;
+	}
+
+	ASTCacheHeader header;
+	memcpy(&header, data.data(), sizeof(header));
+	FlatNode *nodes = (FlatNode*)&data[sizeof(header)];
+	for(int i = 0; i < header.NodeNum; i++){
+		if(corruption == VARIABLE_NAME && nodes[i].Kind == FLAT_VARIABLE){
+			nodes[i].Value = findString(data, header, "f");
+			return;
+		}else if(corruption == CALLEE_NAME && nodes[i].Kind == FLAT_CALL){
+			nodes[i].Value = findString(data, header, "x");
+			return;
+		}else if(corruption == CALL_ARG_NUM && nodes[i].Kind == FLAT_CALL){
+			nodes[i].Count = 0;
+			return;
+		}else if(corruption == NULL_OPERAND && nodes[i].Kind == FLAT_NUMBER && nodes[i].Value == 2){
+			nodes[i].Kind = FLAT_NULL;
+			return;
+		}else if(corruption == NESTED_RETURN && nodes[i].Kind == FLAT_CALL){
+			nodes[i].Kind = FLAT_RETURN;
+			nodes[i].Count = 0;
+			return;
+		}
+	}
+}
+
+/**
+ * キャッシュに書き込み、書き換えてから読み込む
+ * @param キャッシュディレクトリ, ソースファイル名, 書き換え方
+ * @return 読み込めた場合:true 読み込めなかった場合:false
+ */
+static bool storeAndLoad(const std::string &dir, const std::string &source_file, Corruption corruption){
+	Parser parser(source_file);
+	FlatAST flat;
+	ASTCache cache(dir);
+	if(!parser.doParse() || !flat.build(parser.getAST()) ||
+			!cache.open(source_file, "") || !cache.store(flat)){
+		fprintf(stderr, "error at writing AST cache\n");
+		exit(1);
+	}
+
+	std::string data = readFile(cache.getFileName());
+	corrupt(data, corruption);
+	writeFile(cache.getFileName(), data);
+
+	FlatAST loaded;
+	bool result = cache.load(loaded);
+	unlink(cache.getFileName().c_str());
+	return result;
+}
+
+/**
+ * main関数
+ */
+int main(){
+	char dir[] = "/tmp/astcachetestXXXXXX";
+	if(!mkdtemp(dir)){
+		fprintf(stderr, "error at creating temporary directory\n");
+		return 1;
+	}
+	std::string source_file = std::string(dir) + "/test.dc";
+	writeFile(source_file, Source);
+
+	struct{
+		const char *Name;
+		Corruption Kind;
+		bool Expected;
+	} cases[] = {
+		{"intact", NONE, true},
+		{"truncated", TRUNCATE, false},
+		{"variable names a function", VARIABLE_NAME, false},
+		{"callee names a variable", CALLEE_NAME, false},
+		{"call argument count", CALL_ARG_NUM, false},
+		{"null operand", NULL_OPERAND, false},
+		{"nested return", NESTED_RETURN, false},
+	};
+	int case_num = sizeof(cases) / sizeof(cases[0]);
+	int failed = 0;
+	for(int i = 0; i < case_num; i++){
+		if(storeAndLoad(dir, source_file, cases[i].Kind) != cases[i].Expected){
+			fprintf(stdout, "FAIL %s: expected %s\n", cases[i].Name, cases[i].Expected ? "hit" : "miss");
+			failed++;
+		}
+	}
+	unlink(source_file.c_str());
+	rmdir(dir);
+
+	fprintf(stdout, "%d of %d cases passed\n", case_num - failed, case_num);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+/**
+ * ParallelLexicalAnalysisのテスト
+ *
+ * 使い方:
+ *   lexparalleltest
+ *   分割の境界をまたぐブロックコメントを含むソースを並列に字句解析し、
+ *   逐次の字句解析とトークン種別・シンボル番号を比べる（一致しない場合は終了コード1で終わる）
+ *
+ * ビルド:
+ *   g++ -O2 -Iinc `llvm-config --cxxflags` -o lexparalleltest test/lexparalleltest.cpp \
+ *       src/lexer.cpp src/charscan.cpp src/threadpool.cpp src/symbol.cpp -lpthread
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "lexer.hpp"
+
+/**
+ * 関数定義をnum個並べたソースを作る
+ * 中央付近のブロックコメントは複数の分割にまたがり、コメント内にだけ現れる識別子を含む
+ * @param 関数定義の数
+ * @return ソース
+ */
+static std::string makeSource(int num){
+	std::string source;
+	char buf[64];
+	for(int i = 0; i < num; i++){
+		if(i == num * 3 / 10)
+			source += "/*\n";
+		if(i == num * 6 / 10)
+			source += "int commentOnly(int a){\n\treturn a;\n}\n";
+		if(i == num * 7 / 10)
+			source += "*/\n";
+		snprintf(buf, sizeof(buf), "int f%d(int a){\n\treturn a;\n}\n", i);
+		source += buf;
+	}
+	return source;
+}
+
+/**
+ * main関数
+ */
+int main(){
+	// 256KB単位で分割されるように2MB程度のソースを作る
+	std::string source = makeSource(80000);
+
+	// 共有のStringInternerが空の状態で並列に字句解析する
+	SourceBuffer *parallel_source = SourceBuffer::copy(source.data(), source.size());
+	TokenStream parallel;
+	parallel.setSource(parallel_source);
+	if(!ParallelLexicalAnalysis(parallel_source, &parallel, 2)){
+		fprintf(stdout, "FAIL parallel lexing failed\n");
+		return 1;
+	}
+
+	// 別のStringInternerで逐次に字句解析する
+	SourceBuffer *serial_source = SourceBuffer::copy(source.data(), source.size());
+	TokenStream serial;
+	serial.setSource(serial_source);
+	StringInterner serial_symbols;
+	Lexer lex(serial_source);
+	lex.setInterner(&serial_symbols);
+	if(!LexicalAnalysis(&lex, &serial)){
+		fprintf(stdout, "FAIL serial lexing failed\n");
+		return 1;
+	}
+
+	int failed = 0;
+	if(StringInterner::getGlobal().find("commentOnly", 11) >= 0){
+		fprintf(stdout, "FAIL identifier in comment was interned\n");
+		failed++;
+	}
+	while(true){
+		if(parallel.getCurType() != serial.getCurType() ||
+				parallel.getCurOffset() != serial.getCurOffset() ||
+				parallel.getCurLine() != serial.getCurLine() ||
+				parallel.getCurNumVal() != serial.getCurNumVal()){
+			fprintf(stdout, "FAIL token %d: parallel %s (%d), serial %s (%d)\n", parallel.getCurIndex(),
+					parallel.getCurString().c_str(), parallel.getCurNumVal(),
+					serial.getCurString().c_str(), serial.getCurNumVal());
+			failed++;
+			break;
+		}
+		if(parallel.getCurType() == TOK_EOF)
+			break;
+		parallel.getNextToken();
+		serial.getNextToken();
+	}
+
+	fprintf(stdout, failed ? "failed\n" : "passed\n");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * Parser::reparseのテスト
+ *
+ * 使い方:
+ *   reparsetest
+ *   各ケースで編集後のソースを再解析し、ソース全体を解析し直した結果と
+ *   関数宣言・関数定義の並びを比べる（失敗したケースを表示し、終了コード1で終わる）
+ *
+ * ビルド:
+ *   g++ -O2 -Iinc `llvm-config --cxxflags` -o reparsetest test/reparsetest.cpp \
+ *       src/lexer.cpp src/charscan.cpp src/threadpool.cpp src/symbol.cpp src/parsestats.cpp src/arena.cpp \
+ *       src/parser.cpp src/AST.cpp -lpthread
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include "parser.hpp"
+
+/**
+ * 再解析のテストケース（編集前のソースのBegin文字目からのOldLength文字をInsertに置き換える）
+ */
+struct ReparseCase{
+	const char *Name;
+	const char *Source;
+	int Begin;
+	int OldLength;
+	const char *Insert;
+};
+
+static const ReparseCase Cases[] = {
+	{"edit statement", "int f(){return 1;}\nint main(){return 0;}\n", 15, 1, "2 + 3"},
+	{"insert function", "int f(){return 1;}\nint main(){return 0;}\n", 19, 0, "int g(){return 2;}\n"},
+	{"block comment", "int f(){return 1;}\nint g(){return 2;}\nint main(){return 0;}\n", 18, 0, " /*"},
+	{"line comment", "int f(){return 1;} int g(){return 2;}\nint main(){return 0;}\n", 18, 0, " //"},
+	{"line comment at end", "int f(){return 1;}\nint main(){return 0;} int g(){return 2;}", 40, 0, " //"},
+	{"rename function", "int f(){return 1;}\nint main(){return f();}\n", 4, 1, "h"},
+};
+
+/**
+ * ソースをファイルに書き出す
+ * @param ファイル名, ソース
+ */
+static void writeSource(const std::string &file_name, const std::string &source){
+	FILE *fp = fopen(file_name.c_str(), "wb");
+	fwrite(source.data(), 1, source.size(), fp);
+	fclose(fp);
+}
+
+/**
+ * 関数宣言・関数定義の並びを文字列にする
+ * @param TranslationUnitAST
+ * @return 関数名と引数の数を並べた文字列
+ */
+static std::string dumpDeclarations(TranslationUnitAST &tunit){
+	std::string dump;
+	char buf[32];
+	for(int i = 0; PrototypeAST *proto = tunit.getPrototype(i); i++){
+		snprintf(buf, sizeof(buf), "/%d ", proto->getParamNum());
+		dump += "proto " + proto->getName() + buf;
+	}
+	for(int i = 0; FunctionAST *func = tunit.getFunction(i); i++){
+		snprintf(buf, sizeof(buf), "/%d ", func->getPrototype()->getParamNum());
+		dump += "func " + func->getPrototype()->getName() + buf;
+	}
+	return dump;
+}
+
+/**
+ * main関数
+ */
+int main(){
+	char file_name[] = "/tmp/reparsetestXXXXXX";
+	int fd = mkstemp(file_name);
+	if(fd < 0){
+		fprintf(stderr, "error at creating temporary file\n");
+		return 1;
+	}
+	close(fd);
+
+	int failed = 0;
+	int case_num = sizeof(Cases) / sizeof(Cases[0]);
+	for(int i = 0; i < case_num; i++){
+		const ReparseCase &c = Cases[i];
+		std::string source = c.Source;
+		std::string edited = source.substr(0, c.Begin) + c.Insert + source.substr(c.Begin + c.OldLength);
+		int new_end = c.Begin + strlen(c.Insert);
+
+		writeSource(file_name, source);
+		Parser incremental(file_name);
+		incremental.doParse();
+		bool reparsed = incremental.reparse(edited.data(), edited.size(), c.Begin, c.Begin + c.OldLength, new_end);
+
+		writeSource(file_name, edited);
+		Parser full(file_name);
+		bool parsed = full.doParse();
+
+		if(reparsed != parsed ||
+				(parsed && dumpDeclarations(incremental.getAST()) != dumpDeclarations(full.getAST()))){
+			fprintf(stdout, "FAIL %s: reparse %s, full parse %s\n", c.Name,
+					reparsed ? dumpDeclarations(incremental.getAST()).c_str() : "failed",
+					parsed ? dumpDeclarations(full.getAST()).c_str() : "failed");
+			failed++;
+		}
+	}
+	unlink(file_name);
+
+	fprintf(stdout, "%d of %d cases passed\n", case_num - failed, case_num);
+	return failed ? 1 : 0;
+}